@@ -0,0 +1,110 @@
+#include "accesspointdecoder.h"
+
+#include <QDBusVariant>
+
+namespace {
+
+typedef AccessPointDecoder::Fields (*PropertySetter)(const QVariant &value, AccessPoint *ap);
+
+AccessPointDecoder::Fields setSsid(const QVariant &value, AccessPoint *ap)
+{
+    const QString ssid = value.toString();
+    if (ap->ssid() == ssid)
+        return AccessPointDecoder::NoField;
+    ap->setSsid(ssid);
+    return AccessPointDecoder::SsidField;
+}
+
+AccessPointDecoder::Fields setConnected(const QVariant &value, AccessPoint *ap)
+{
+    const bool connected = value.toBool();
+    if (ap->connected() == connected)
+        return AccessPointDecoder::NoField;
+    ap->setConnected(connected);
+    return AccessPointDecoder::ConnectedField;
+}
+
+AccessPointDecoder::Fields setStrength(const QVariant &value, AccessPoint *ap)
+{
+    const int strength = value.toInt();
+    if (ap->strength() == strength)
+        return AccessPointDecoder::NoField;
+    ap->setStrength(strength);
+    return AccessPointDecoder::StrengthField;
+}
+
+AccessPointDecoder::Fields setSecurity(const QVariant &value, AccessPoint *ap)
+{
+    const ConnectivityModule::SecurityType security = AccessPointDecoder::securityType(value.toString());
+    if (ap->security() == security)
+        return AccessPointDecoder::NoField;
+    ap->setSecurity(security);
+    return AccessPointDecoder::SecurityField;
+}
+
+struct PropertyEntry
+{
+    const char *name;
+    int length;
+    AccessPointDecoder::Field field;
+    PropertySetter setter;
+};
+
+// Keep in sync with com.luxoft.ConnectivityManager.WiFiAccessPoint
+constexpr PropertyEntry propertyTable[] = {
+    { "SSID", 4, AccessPointDecoder::SsidField, &setSsid },
+    { "Connected", 9, AccessPointDecoder::ConnectedField, &setConnected },
+    { "Strength", 8, AccessPointDecoder::StrengthField, &setStrength },
+    { "Security", 8, AccessPointDecoder::SecurityField, &setSecurity },
+};
+
+const PropertyEntry *findProperty(const QString &propertyName)
+{
+    for (const PropertyEntry &entry : propertyTable) {
+        if (entry.length == propertyName.size() && propertyName == QLatin1String(entry.name, entry.length))
+            return &entry;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+
+AccessPointDecoder::Fields AccessPointDecoder::decode(const QDBusArgument &properties, AccessPoint *ap, Fields fields)
+{
+    Fields changed;
+
+    properties.beginMap();
+    while (!properties.atEnd()) {
+        properties.beginMapEntry();
+        QString propertyName;
+        properties >> propertyName;
+
+        // endMapEntry() skips over a value which was not read
+        const PropertyEntry *entry = findProperty(propertyName);
+        if (entry && (fields & entry->field)) {
+            QDBusVariant propertyValue;
+            properties >> propertyValue;
+            changed |= entry->setter(propertyValue.variant(), ap);
+        }
+
+        properties.endMapEntry();
+    }
+    properties.endMap();
+
+    return changed;
+}
+
+
+ConnectivityModule::SecurityType AccessPointDecoder::securityType(const QString &securityString)
+{
+    ConnectivityModule::SecurityType security = ConnectivityModule::SecurityType::NoSecurity;
+    if (securityString == QLatin1String("wep")) {
+        security = ConnectivityModule::SecurityType::WEP;
+    } else if (securityString == QLatin1String("wpa-psk")) {
+        security = ConnectivityModule::SecurityType::WPA_PSK;
+    } else if (securityString == QLatin1String("wpa-eap")) {
+        security = ConnectivityModule::SecurityType::WPA_EAP;
+    }
+    return security;
+}
@@ -0,0 +1,39 @@
+#ifndef CONNECTIVITY_ACCESSPOINTDECODER_H_
+#define CONNECTIVITY_ACCESSPOINTDECODER_H_
+
+#include <QDBusArgument>
+#include <QFlags>
+#include <QString>
+
+#include "accesspoint.h"
+#include "connectivitymodule.h"
+
+/*
+ * Decodes the a{sv} properties of a WiFiAccessPoint object into an AccessPoint.
+ *
+ * Property names are dispatched through a table built at compile time, values
+ * are only unpacked for the properties we consume, and the fields whose value
+ * actually changed are returned so that unchanged updates can be dropped.
+ */
+class AccessPointDecoder
+{
+public:
+    enum Field {
+        NoField = 0x0,
+        SsidField = 0x1,
+        ConnectedField = 0x2,
+        StrengthField = 0x4,
+        SecurityField = 0x8,
+        AllFields = SsidField | ConnectedField | StrengthField | SecurityField
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    // Reads a whole a{sv} map from the argument, only the given fields are applied
+    static Fields decode(const QDBusArgument &properties, AccessPoint *ap, Fields fields = AllFields);
+
+    static ConnectivityModule::SecurityType securityType(const QString &securityString);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(AccessPointDecoder::Fields)
+
+#endif // CONNECTIVITY_ACCESSPOINTDECODER_H_
@@ -0,0 +1,199 @@
+#include "accesspointmodel.h"
+
+#include <QHash>
+#include <QSet>
+
+namespace {
+
+// Counts of the rows not yet placed by sync(), by their row before the walk
+class PendingRows
+{
+public:
+    explicit PendingRows(int count) : m_tree(count + 1, 0)
+    {
+        for (int row = 0; row < count; ++row)
+            add(row, 1);
+    }
+
+    // Pending rows before row
+    int countBefore(int row) const
+    {
+        int count = 0;
+        for (int i = row; i > 0; i -= i & -i)
+            count += m_tree.at(i);
+        return count;
+    }
+
+    void take(int row) { add(row, -1); }
+
+private:
+    void add(int row, int delta)
+    {
+        for (int i = row + 1; i < m_tree.count(); i += i & -i)
+            m_tree[i] += delta;
+    }
+
+    QVector<int> m_tree;
+};
+
+} // namespace
+
+
+AccessPointModel::AccessPointModel(QObject *parent) : QAbstractListModel(parent)
+{
+}
+
+
+int AccessPointModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_rows.count();
+}
+
+
+QVariant AccessPointModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.count())
+        return QVariant();
+
+    const Row &row = m_rows.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case SsidRole:
+        return row.accessPoint.ssid();
+    case ConnectedRole:
+        return row.accessPoint.connected();
+    case StrengthRole:
+        return row.accessPoint.strength();
+    case SecurityRole:
+        return QVariant::fromValue(row.accessPoint.security());
+    case ObjectPathRole:
+        return row.objectPath;
+    }
+    return QVariant();
+}
+
+
+QHash<int, QByteArray> AccessPointModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[SsidRole] = "ssid";
+    roles[ConnectedRole] = "connected";
+    roles[StrengthRole] = "strength";
+    roles[SecurityRole] = "security";
+    roles[ObjectPathRole] = "objectPath";
+    return roles;
+}
+
+
+void AccessPointModel::sync(const AccessPointStore &store)
+{
+    // Only the paths we already have properties for are shown
+    QVector<AccessPointStore::PathId> target;
+    target.reserve(store.order().count());
+    QSet<QString> targetSet;
+    for (AccessPointStore::PathId id : store.order()) {
+        if (store.contains(id)) {
+            target.append(id);
+            targetSet.insert(store.objectPath(id));
+        }
+    }
+
+    // Drop rows that went away, from the end so the indexes stay valid
+    for (int row = m_rows.count() - 1; row >= 0; --row) {
+        if (targetSet.contains(m_rows.at(row).objectPath))
+            continue;
+        int first = row;
+        while (first > 0 && !targetSet.contains(m_rows.at(first - 1).objectPath))
+            --first;
+        beginRemoveRows(QModelIndex(), first, row);
+        m_rows.remove(first, row - first + 1);
+        endRemoveRows();
+        row = first;
+    }
+
+    // Walk the target order, moving or inserting rows into place. The rows after i are the
+    // remaining ones in their previous order, so a row's current index follows from the
+    // number of remaining rows before it, without scanning.
+    QHash<QString, int> previousRows;
+    previousRows.reserve(m_rows.count());
+    for (int row = 0; row < m_rows.count(); ++row)
+        previousRows.insert(m_rows.at(row).objectPath, row);
+    PendingRows pendingRows(m_rows.count());
+
+    for (int i = 0; i < target.count(); ++i) {
+        const QString &objectPath = store.objectPath(target.at(i));
+        const AccessPoint &ap = store.accessPoint(target.at(i));
+
+        const auto previous = previousRows.constFind(objectPath);
+        if (previous == previousRows.constEnd()) {
+            beginInsertRows(QModelIndex(), i, i);
+            m_rows.insert(i, Row{objectPath, ap});
+            endInsertRows();
+            continue;
+        }
+
+        const int from = i + pendingRows.countBefore(previous.value());
+        pendingRows.take(previous.value());
+        if (from == i) {
+            updateRow(i, ap);
+        } else {
+            beginMoveRows(QModelIndex(), from, from, QModelIndex(), i);
+            m_rows.move(from, i);
+            endMoveRows();
+            updateRow(i, ap);
+        }
+    }
+}
+
+
+void AccessPointModel::updateAccessPoint(const QString &objectPath, const AccessPoint &ap)
+{
+    const int row = indexOf(objectPath);
+    if (row >= 0)
+        updateRow(row, ap);
+}
+
+
+void AccessPointModel::clear()
+{
+    if (m_rows.isEmpty())
+        return;
+    beginResetModel();
+    m_rows.clear();
+    endResetModel();
+}
+
+
+int AccessPointModel::indexOf(const QString &objectPath, int from) const
+{
+    for (int row = from; row < m_rows.count(); ++row) {
+        if (m_rows.at(row).objectPath == objectPath)
+            return row;
+    }
+    return -1;
+}
+
+
+void AccessPointModel::updateRow(int row, const AccessPoint &ap)
+{
+    AccessPoint &current = m_rows[row].accessPoint;
+
+    QVector<int> roles;
+    if (current.ssid() != ap.ssid())
+        roles << SsidRole << Qt::DisplayRole;
+    if (current.connected() != ap.connected())
+        roles << ConnectedRole;
+    if (current.strength() != ap.strength())
+        roles << StrengthRole;
+    if (current.security() != ap.security())
+        roles << SecurityRole;
+
+    if (roles.isEmpty())
+        return;
+
+    current = ap;
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, roles);
+}
@@ -0,0 +1,56 @@
+#ifndef CONNECTIVITY_ACCESSPOINTMODEL_H_
+#define CONNECTIVITY_ACCESSPOINTMODEL_H_
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "accesspoint.h"
+#include "accesspointstore.h"
+
+/*
+ * List model of the access points, kept in the order of WiFiAccessPoints.
+ * sync() diffs the new state against the current rows and only emits the row
+ * inserts/removes/moves and the dataChanged roles that are actually needed.
+ */
+class AccessPointModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        SsidRole = Qt::UserRole + 1,
+        ConnectedRole,
+        StrengthRole,
+        SecurityRole,
+        ObjectPathRole
+    };
+    Q_ENUM(Roles)
+
+    explicit AccessPointModel(QObject *parent = nullptr);
+    ~AccessPointModel() = default;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    const QString &objectPath(int row) const { return m_rows.at(row).objectPath; }
+    const AccessPoint &accessPoint(int row) const { return m_rows.at(row).accessPoint; }
+
+    void sync(const AccessPointStore &store);
+    void updateAccessPoint(const QString &objectPath, const AccessPoint &ap);
+    void clear();
+
+private:
+    struct Row
+    {
+        QString objectPath;
+        AccessPoint accessPoint;
+    };
+
+    int indexOf(const QString &objectPath, int from = 0) const;
+    void updateRow(int row, const AccessPoint &ap);
+
+    QVector<Row> m_rows;
+};
+
+#endif // CONNECTIVITY_ACCESSPOINTMODEL_H_
@@ -0,0 +1,103 @@
+#include "accesspointsnapshot.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <QDebug>
+
+#include "accesspointstore.h"
+#include "connectivitymodule.h"
+
+static const quint32 snapshotMagic = 0x50574150; // "PWAP"
+static const quint16 snapshotVersion = 2;
+
+void AccessPointSnapshot::capture(const AccessPointStore &store)
+{
+    entries.clear();
+    entries.reserve(store.count());
+    for (AccessPointStore::PathId id : store.order()) {
+        if (store.contains(id))
+            entries.append(Entry{store.objectPath(id), store.accessPoint(id)});
+    }
+}
+
+
+bool AccessPointSnapshot::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return false;
+
+    uchar *data = file.map(0, file.size());
+    if (!data)
+        return false;
+
+    const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(data), int(file.size()));
+    QDataStream in(raw);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != snapshotMagic || version != snapshotVersion) {
+        file.unmap(data);
+        return false;
+    }
+
+    quint32 count = 0;
+    in >> activeObjectPath >> count;
+
+    entries.clear();
+    entries.reserve(int(qMin<quint32>(count, 4096)));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        QString ssid;
+        qint32 strength = 0;
+        qint32 security = 0;
+        in >> entry.objectPath >> ssid >> strength >> security;
+        entry.accessPoint.setSsid(ssid);
+        entry.accessPoint.setStrength(strength);
+        entry.accessPoint.setSecurity(ConnectivityModule::SecurityType(security));
+        entries.append(entry);
+    }
+
+    const bool ok = (in.status() == QDataStream::Ok);
+    file.unmap(data);
+    if (!ok) {
+        qWarning() << Q_FUNC_INFO << "Discarding corrupt snapshot" << fileName;
+        entries.clear();
+    }
+    return ok;
+}
+
+
+bool AccessPointSnapshot::save(const QString &fileName) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << snapshotMagic << snapshotVersion
+        << activeObjectPath << quint32(entries.count());
+    for (const Entry &entry : entries) {
+        out << entry.objectPath << entry.accessPoint.ssid()
+            << qint32(entry.accessPoint.strength()) << qint32(entry.accessPoint.security());
+    }
+
+    return file.commit();
+}
+
+
+QString AccessPointSnapshot::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/pelux-wifi/accesspoints.snapshot");
+}
@@ -0,0 +1,41 @@
+#ifndef CONNECTIVITY_ACCESSPOINTSNAPSHOT_H_
+#define CONNECTIVITY_ACCESSPOINTSNAPSHOT_H_
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+#include "accesspoint.h"
+
+class AccessPointStore;
+
+/*
+ * Last known WiFi state persisted across restarts, so the access point list
+ * can be painted before the connectivity manager has answered.
+ *
+ * The file is a small versioned binary blob; it is memory-mapped on load and
+ * written atomically. Only the list is kept: whether an access point is
+ * connected and the hotspot state are not known before the manager says so.
+ */
+struct AccessPointSnapshot
+{
+    struct Entry
+    {
+        QString objectPath;
+        AccessPoint accessPoint;
+    };
+
+    QVector<Entry> entries;     // in WiFiAccessPoints order
+    QString activeObjectPath;  // only a hint which access point to fetch first
+
+    void capture(const AccessPointStore &store);
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    static QString defaultFileName();
+};
+
+Q_DECLARE_METATYPE(AccessPointSnapshot)
+
+#endif // CONNECTIVITY_ACCESSPOINTSNAPSHOT_H_
@@ -0,0 +1,202 @@
+#include "accesspointstore.h"
+
+const AccessPointStore::PathId AccessPointStore::InvalidId;
+
+AccessPointStore::PathId AccessPointStore::findBySsid(const QString &ssid) const
+{
+    // The same SSID can be announced by several radios, prefer the strongest one
+    PathId found = InvalidId;
+    for (auto it = m_ssidIds.constFind(ssid); it != m_ssidIds.constEnd() && it.key() == ssid; ++it) {
+        if (found == InvalidId || accessPoint(it.value()).strength() > accessPoint(found).strength())
+            found = it.value();
+    }
+    return found;
+}
+
+
+AccessPointStore::PathId AccessPointStore::insert(const QString &objectPath, const AccessPoint &ap)
+{
+    const PathId id = intern(objectPath);
+    Record &record = m_records[id];
+
+    if (record.present) {
+        if (record.accessPoint.ssid() != ap.ssid()) {
+            m_ssidIds.remove(record.accessPoint.ssid(), id);
+            m_ssidIds.insert(ap.ssid(), id);
+        }
+    } else {
+        record.present = true;
+        m_ssidIds.insert(ap.ssid(), id);
+        ++m_count;
+        ++m_revision;
+    }
+    if (!(record.accessPoint == ap)) {
+        record.accessPoint = ap;
+        ++m_revision;
+    }
+    return id;
+}
+
+
+void AccessPointStore::update(PathId id, const AccessPoint &ap)
+{
+    Record &record = m_records[id];
+    if (record.accessPoint == ap)
+        return;
+
+    if (record.accessPoint.ssid() != ap.ssid()) {
+        m_ssidIds.remove(record.accessPoint.ssid(), id);
+        m_ssidIds.insert(ap.ssid(), id);
+    }
+    record.accessPoint = ap;
+    ++m_revision;
+}
+
+
+void AccessPointStore::setStrength(PathId id, int strength)
+{
+    AccessPoint &ap = m_records[id].accessPoint;
+    if (ap.strength() == strength)
+        return;
+    ap.setStrength(strength);
+    ++m_revision;
+}
+
+
+bool AccessPointStore::remove(const QString &objectPath)
+{
+    const PathId id = pathId(objectPath);
+    if (!contains(id))
+        return false;
+
+    Record &record = m_records[id];
+    m_ssidIds.remove(record.accessPoint.ssid(), id);
+    record.present = false;
+    record.accessPoint = AccessPoint();
+    --m_count;
+    ++m_revision;
+
+    releaseIfUnused(id);
+    return true;
+}
+
+
+void AccessPointStore::clear()
+{
+    m_records.clear();
+    m_freeIds.clear();
+    m_pathIds.clear();
+    m_ssidIds.clear();
+    m_order.clear();
+    m_count = 0;
+    ++m_revision;
+}
+
+
+void AccessPointStore::setOrder(const QList<QDBusObjectPath> &paths)
+{
+    const QVector<PathId> previousOrder = m_order;
+    for (PathId id : previousOrder)
+        m_records[id].ordered = false;
+
+    m_order.clear();
+    m_order.reserve(paths.count());
+    for (const QDBusObjectPath &path : paths) {
+        const PathId id = intern(path.path());
+        if (m_records.at(id).ordered)
+            continue;
+        m_records[id].ordered = true;
+        m_order.append(id);
+    }
+
+    // Only what toVariantList() shows counts, paths without properties yet may move freely
+    bool visibleChanged = false;
+    int position = 0;
+    for (PathId id : previousOrder) {
+        if (!m_records.at(id).present)
+            continue;
+        while (position < m_order.count() && !m_records.at(m_order.at(position)).present)
+            ++position;
+        if (position == m_order.count() || m_order.at(position) != id) {
+            visibleChanged = true;
+            break;
+        }
+        ++position;
+    }
+    while (!visibleChanged && position < m_order.count()) {
+        visibleChanged = m_records.at(m_order.at(position)).present;
+        ++position;
+    }
+
+    for (PathId id : previousOrder)
+        releaseIfUnused(id);
+
+    if (visibleChanged)
+        ++m_revision;
+}
+
+
+QVector<QString> AccessPointStore::paths() const
+{
+    QVector<QString> paths;
+    paths.reserve(m_count);
+    for (const Record &record : m_records) {
+        if (record.present)
+            paths.append(record.objectPath);
+    }
+    return paths;
+}
+
+
+QVector<QString> AccessPointStore::unorderedPaths() const
+{
+    QVector<QString> paths;
+    for (const Record &record : m_records) {
+        if (record.present && !record.ordered)
+            paths.append(record.objectPath);
+    }
+    return paths;
+}
+
+
+QVariantList AccessPointStore::toVariantList() const
+{
+    QVariantList list;
+    list.reserve(m_order.count());
+    for (PathId id : m_order) {
+        const Record &record = m_records.at(id);
+        if (record.present)
+            list.append(QVariant::fromValue(record.accessPoint));
+    }
+    return list;
+}
+
+
+AccessPointStore::PathId AccessPointStore::intern(const QString &objectPath)
+{
+    PathId id = pathId(objectPath);
+    if (id != InvalidId)
+        return id;
+
+    if (!m_freeIds.isEmpty()) {
+        id = m_freeIds.takeLast();
+    } else {
+        id = m_records.count();
+        m_records.append(Record());
+    }
+    m_records[id].objectPath = objectPath;
+    m_pathIds.insert(objectPath, id);
+    return id;
+}
+
+
+void AccessPointStore::releaseIfUnused(PathId id)
+{
+    Record &record = m_records[id];
+    if (record.present || record.ordered || record.objectPath.isEmpty())
+        return;
+
+    m_pathIds.remove(record.objectPath);
+    record = Record();
+    m_freeIds.append(id);
+}
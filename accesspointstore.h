@@ -0,0 +1,81 @@
+#ifndef CONNECTIVITY_ACCESSPOINTSTORE_H_
+#define CONNECTIVITY_ACCESSPOINTSTORE_H_
+
+#include <QDBusObjectPath>
+#include <QHash>
+#include <QMultiHash>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include "accesspoint.h"
+
+/*
+ * Access points known to the backend, keyed by their D-Bus object path.
+ *
+ * Records live unboxed in one contiguous vector and are addressed by an
+ * interned path id, which stays stable for as long as the path is either
+ * present or part of the WiFiAccessPoints order. Path and SSID lookups are
+ * hash lookups, the published order is kept as a vector of ids.
+ *
+ * Every change that can be seen in toVariantList() bumps revision(), so
+ * copies of the store can be compared without looking at their content.
+ */
+class AccessPointStore
+{
+public:
+    typedef int PathId;
+    static const PathId InvalidId = -1;
+
+    PathId pathId(const QString &objectPath) const { return m_pathIds.value(objectPath, InvalidId); }
+    PathId findBySsid(const QString &ssid) const;
+
+    bool contains(const QString &objectPath) const { return contains(pathId(objectPath)); }
+    bool contains(PathId id) const { return id >= 0 && id < m_records.count() && m_records.at(id).present; }
+
+    const QString &objectPath(PathId id) const { return m_records.at(id).objectPath; }
+    const AccessPoint &accessPoint(PathId id) const { return m_records.at(id).accessPoint; }
+
+    PathId insert(const QString &objectPath, const AccessPoint &ap);
+    bool remove(const QString &objectPath);
+
+    // Replaces the record of a present access point, revision() only moves if it differs
+    void update(PathId id, const AccessPoint &ap);
+    void setStrength(PathId id, int strength);
+    void clear();
+
+    int count() const { return m_count; }
+    quint64 revision() const { return m_revision; }
+
+    void setOrder(const QList<QDBusObjectPath> &paths);
+    const QVector<PathId> &order() const { return m_order; }
+    bool isOrdered(PathId id) const { return m_records.at(id).ordered; }
+
+    QVector<QString> paths() const;
+    // Present access points which are not part of the current order
+    QVector<QString> unorderedPaths() const;
+
+    QVariantList toVariantList() const;
+
+private:
+    struct Record
+    {
+        QString objectPath;
+        AccessPoint accessPoint;
+        bool present = false;
+        bool ordered = false;
+    };
+
+    PathId intern(const QString &objectPath);
+    void releaseIfUnused(PathId id);
+
+    QVector<Record> m_records;
+    QVector<PathId> m_freeIds;
+    QHash<QString, PathId> m_pathIds;
+    QMultiHash<QString, PathId> m_ssidIds;
+    QVector<PathId> m_order;
+    int m_count = 0;
+    quint64 m_revision = 0;
+};
+
+#endif // CONNECTIVITY_ACCESSPOINTSTORE_H_
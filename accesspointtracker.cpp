@@ -0,0 +1,857 @@
+#include "accesspointtracker.h"
+
+#include <QDBusArgument>
+#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QElapsedTimer>
+
+#include <QDebug>
+
+#include "accesspointdecoder.h"
+#include "wifibackend.h"
+
+// Per-AP GetAll calls on the bus at the same time, about a screen of rows
+static const int maxFetchesInFlight = 8;
+
+// WiFiAccessPoints out of the a{sv} properties of a WiFiDevice
+static QList<QDBusObjectPath> accessPointPaths(const QDBusArgument &properties)
+{
+    QVariantMap map;
+    properties >> map;
+
+    QList<QDBusObjectPath> paths;
+    const QDBusArgument arg = map.value(QStringLiteral("WiFiAccessPoints")).value<QDBusArgument>();
+    arg.beginArray();
+    while (!arg.atEnd()) {
+        QDBusObjectPath path;
+        arg >> path;
+        paths.append(path);
+    }
+    arg.endArray();
+    return paths;
+}
+
+AccessPointTracker::AccessPointTracker(BackendMetrics *metrics, QObject *parent) : QObject(parent)
+    , m_metrics(metrics)
+    , m_connection(QString())
+    , m_strengthTimer(this)
+    , m_listUpdateScheduler(new UpdateScheduler(this))
+    , m_publishScheduler(new UpdateScheduler(this))
+    , m_snapshot(std::make_shared<const AccessPointListSnapshot>())
+{
+    // The owner coalesces the notifications again, here only the cost of building
+    // snapshots during scan storms has to be bounded.
+    m_publishScheduler->setPolicy(UpdateScheduler::FrameAligned);
+
+    m_clock.start();
+    m_strengthTimer.setSingleShot(true);
+    QObject::connect(&m_strengthTimer, &QTimer::timeout, this, &AccessPointTracker::applyDeferredStrengths);
+
+    QObject::connect(m_listUpdateScheduler, &UpdateScheduler::triggered, this, &AccessPointTracker::updateAccessPoints);
+    QObject::connect(m_publishScheduler, &UpdateScheduler::triggered, this, &AccessPointTracker::publish);
+}
+
+
+AccessPointTracker::~AccessPointTracker()
+{
+    if (!m_connectionName.isEmpty()) {
+        QDBusConnection::disconnectFromBus(m_connectionName);
+    }
+}
+
+
+void AccessPointTracker::restore(const AccessPointSnapshot &snapshot)
+{
+    QList<QDBusObjectPath> paths;
+    for (const AccessPointSnapshot::Entry &entry : snapshot.entries) {
+        m_store.insert(entry.objectPath, entry.accessPoint);
+        m_stalePaths.insert(entry.objectPath);
+        paths.append(QDBusObjectPath(entry.objectPath));
+    }
+    m_store.setOrder(paths);
+
+    // Most likely still the one we are connected to, confirmed first
+    m_priorityPath = snapshot.activeObjectPath;
+
+    // First paint right away, the live state reconciles it afterwards
+    publish();
+}
+
+
+void AccessPointTracker::start(const QString &connectionName)
+{
+    if (connectionName.isEmpty()) {
+        m_connection = WiFiBackend::dbusConnection();
+    } else {
+        m_connectionName = connectionName;
+        m_connection = QDBusConnection::connectToBus(QDBusConnection::SystemBus, connectionName);
+    }
+
+    subscribe();
+    // Also when suspended, this is where the active access point is learned from.
+    // Unless the reporting tracker has handed this device's share of its reply already.
+    if (!m_adopted) {
+        fetchManagedObjects();
+    }
+}
+
+
+void AccessPointTracker::setExclusive(bool exclusive)
+{
+    if (m_exclusive == exclusive)
+        return;
+    m_exclusive = exclusive;
+
+    // Access points of other devices move out of the store
+    m_listUpdateScheduler->schedule();
+}
+
+
+void AccessPointTracker::setReportDevices(bool reportDevices)
+{
+    m_reportDevices = reportDevices;
+}
+
+
+void AccessPointTracker::setBulkFetchShared(bool shared)
+{
+    m_bulkFetchShared = shared;
+}
+
+
+void AccessPointTracker::setPropertiesChangedRouted(bool routed)
+{
+    m_propertiesChangedRouted = routed;
+}
+
+
+void AccessPointTracker::adopt(const AccessPointSnapshot &accessPoints)
+{
+    m_adopted = true;
+    m_resyncPending = false;
+    m_objectManagerState = ObjectManagerState::Available;
+
+    // Only a first list, the device's own WiFiAccessPoints are newer than the reply
+    if (m_store.order().isEmpty()) {
+        QList<QDBusObjectPath> paths;
+        for (const AccessPointSnapshot::Entry &entry : accessPoints.entries)
+            paths.append(QDBusObjectPath(entry.objectPath));
+        ++m_listGeneration;
+        m_store.setOrder(paths);
+    }
+
+    for (const AccessPointSnapshot::Entry &entry : accessPoints.entries) {
+        insertAccessPoint(entry.objectPath, entry.accessPoint);
+    }
+
+    removeStalePaths();
+    // Listed paths which were not part of the reply are fetched one by one
+    m_listUpdateScheduler->schedule();
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::serviceLost()
+{
+    m_objectManagerState = ObjectManagerState::Unknown;
+    m_unlisted.clear();
+    // Nothing is fetched from a manager which left the bus, the queue is refilled once
+    // resync() has learned how the new instance exports its access points
+    m_fetchQueue.clear();
+    m_fetchesInFlight.clear();
+    const QVector<QString> paths = m_store.paths();
+    for (const QString &path : paths)
+        m_stalePaths.insert(path);
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::resync()
+{
+    ++m_generation;
+    m_resyncPending = true;
+
+    // The match rules were resolved against the previous owner of the name
+    unsubscribe();
+    subscribe();
+
+    // Only what differs from the store reaches the model, the rest is confirmed in place
+    m_objectManagerState = ObjectManagerState::Unknown;
+    if (!m_bulkFetchShared) {
+        fetchManagedObjects();
+    }
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::subscribe()
+{
+    // Suspended, only the active access point is followed
+    if (m_suspended) {
+        watchPath(m_priorityPath);
+    } else {
+        subscribeAccessPoints();
+    }
+
+    m_connection.connect(connectivityDBusService, connectivityDBusPath, dbusObjectManagerInterface,
+            QStringLiteral("InterfacesAdded"), this, SLOT(interfacesAddedHandler(QDBusMessage)));
+    m_connection.connect(connectivityDBusService, connectivityDBusPath, dbusObjectManagerInterface,
+            QStringLiteral("InterfacesRemoved"), this, SLOT(interfacesRemovedHandler(QDBusMessage)));
+}
+
+
+void AccessPointTracker::unsubscribe()
+{
+    if (m_suspended) {
+        watchPath(QString());
+    } else {
+        unsubscribeAccessPoints();
+    }
+
+    m_connection.disconnect(connectivityDBusService, connectivityDBusPath, dbusObjectManagerInterface,
+            QStringLiteral("InterfacesAdded"), this, SLOT(interfacesAddedHandler(QDBusMessage)));
+    m_connection.disconnect(connectivityDBusService, connectivityDBusPath, dbusObjectManagerInterface,
+            QStringLiteral("InterfacesRemoved"), this, SLOT(interfacesRemovedHandler(QDBusMessage)));
+}
+
+
+void AccessPointTracker::subscribeAccessPoints()
+{
+    // One match rule for the PropertiesChanged of every access point, whatever their number.
+    // QtDBus cannot express path_namespace, so the rule matches on sender and arg0 instead and
+    // the handler routes the messages by their path. Routed trackers get theirs handed on.
+    if (!m_propertiesChangedRouted) {
+        m_connection.connect(connectivityDBusService, QString(), dbusPropertyInterface, QStringLiteral("PropertiesChanged"),
+                QStringList() << accessPointDBusInterface, QString(),
+                this, SLOT(propertiesChangedHandler(QDBusMessage)));
+    }
+}
+
+
+void AccessPointTracker::unsubscribeAccessPoints()
+{
+    if (!m_propertiesChangedRouted) {
+        m_connection.disconnect(connectivityDBusService, QString(), dbusPropertyInterface, QStringLiteral("PropertiesChanged"),
+                QStringList() << accessPointDBusInterface, QString(),
+                this, SLOT(propertiesChangedHandler(QDBusMessage)));
+    }
+}
+
+
+void AccessPointTracker::watchPath(const QString &dbusObjPath)
+{
+    if (m_watchedPath == dbusObjPath)
+        return;
+
+    if (!m_watchedPath.isEmpty()) {
+        m_connection.disconnect(connectivityDBusService, m_watchedPath, dbusPropertyInterface, QStringLiteral("PropertiesChanged"),
+                QStringList() << accessPointDBusInterface, QString(),
+                this, SLOT(propertiesChangedHandler(QDBusMessage)));
+    }
+
+    m_watchedPath = dbusObjPath;
+    if (!m_watchedPath.isEmpty()) {
+        m_connection.connect(connectivityDBusService, m_watchedPath, dbusPropertyInterface, QStringLiteral("PropertiesChanged"),
+                QStringList() << accessPointDBusInterface, QString(),
+                this, SLOT(propertiesChangedHandler(QDBusMessage)));
+    }
+}
+
+
+void AccessPointTracker::setSuspended(bool suspended)
+{
+    if (m_suspended == suspended)
+        return;
+
+    // Not started yet, start() subscribes for the mode it finds
+    if (!m_connection.isConnected()) {
+        m_suspended = suspended;
+        return;
+    }
+
+    if (suspended) {
+        // No per-AP signals or GetAll calls anymore, a path match for the active access point
+        // replaces the rule for all of them. Outstanding replies are discarded, the list is
+        // caught up with on resume.
+        unsubscribeAccessPoints();
+        m_suspended = true;
+        watchPath(m_priorityPath);
+        m_fetchQueue.clear();
+        m_fetchesInFlight.clear();
+        m_unlisted.clear();
+        return;
+    }
+
+    m_suspended = false;
+    watchPath(QString());
+    subscribeAccessPoints();
+
+    // Only the connection was followed in the meantime: one GetManagedObjects confirms what
+    // is still there and refreshes the rest, as after a restart of the manager
+    const QVector<QString> paths = m_store.paths();
+    for (const QString &path : paths)
+        m_stalePaths.insert(path);
+    m_resyncPending = true;
+    m_objectManagerState = ObjectManagerState::Unknown;
+    if (!m_bulkFetchShared) {
+        fetchManagedObjects();
+    }
+    m_listUpdateScheduler->schedule();
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::setAccessPointPaths(const QList<QDBusObjectPath> &paths)
+{
+    ++m_listGeneration;
+    m_store.setOrder(paths);
+    m_listUpdateScheduler->schedule();
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::setStrengthFilter(const QVariantList &thresholds, int hysteresis, int minInterval)
+{
+    QVector<int> bucketThresholds;
+    for (const QVariant &threshold : thresholds)
+        bucketThresholds.append(threshold.toInt());
+
+    m_strengthFilter.setThresholds(bucketThresholds);
+    m_strengthFilter.setHysteresis(hysteresis);
+    m_strengthFilter.setMinInterval(minInterval);
+    scheduleDeferredStrengths();
+}
+
+
+void AccessPointTracker::publish()
+{
+    const AccessPointListSnapshotPtr previous = m_snapshot;
+    const bool stale = !m_stalePaths.isEmpty() || m_resyncPending;
+    const bool flagsChanged = stale != previous->stale || m_generation != previous->generation;
+    const bool storeChanged = m_store.revision() != previous->store.revision();
+    if (!storeChanged && !flagsChanged) {
+        return;
+    }
+
+    QString connectedObjectPath;
+    for (AccessPointStore::PathId id : m_store.order()) {
+        if (m_store.contains(id) && m_store.accessPoint(id).connected()) {
+            connectedObjectPath = m_store.objectPath(id);
+            break;
+        }
+    }
+
+    // Nobody looks at the list, only the connection is followed
+    if (m_suspended && !flagsChanged && connectedObjectPath == previous->connectedObjectPath) {
+        const AccessPointStore::PathId id = m_store.pathId(connectedObjectPath);
+        const AccessPointStore::PathId previousId = previous->store.pathId(connectedObjectPath);
+        if (connectedObjectPath.isEmpty()
+                || (previous->store.contains(previousId) && previous->store.accessPoint(previousId) == m_store.accessPoint(id))) {
+            return;
+        }
+    }
+
+    auto snapshot = std::make_shared<AccessPointListSnapshot>();
+    snapshot->version = ++m_version;
+    snapshot->stale = stale;
+    snapshot->generation = m_generation;
+
+    if (!storeChanged) {
+        // Implicitly shared with the previous snapshot, readers can tell by the revision
+        snapshot->store = previous->store;
+        snapshot->accessPoints = previous->accessPoints;
+        snapshot->connectedObjectPath = previous->connectedObjectPath;
+    } else {
+        snapshot->store = m_store;
+        snapshot->accessPoints = m_store.toVariantList();
+        snapshot->connectedObjectPath = connectedObjectPath;
+    }
+
+    std::atomic_store(&m_snapshot, AccessPointListSnapshotPtr(std::move(snapshot)));
+    emit published(m_version);
+}
+
+
+void AccessPointTracker::updateAccessPoints()
+{
+    QSet<QString> fetchQueue;
+    const QVector<AccessPointStore::PathId> order = m_store.order();
+    for (AccessPointStore::PathId id : order) {
+        const QString dbusObjPath = m_store.objectPath(id);
+        if ( m_store.contains(id) && !m_stalePaths.contains(dbusObjPath) ) {
+            continue;
+        }
+
+        // Announced before this device listed it
+        const auto unlisted = m_unlisted.find(dbusObjPath);
+        if (unlisted != m_unlisted.end()) {
+            const AccessPoint ap = unlisted.value();
+            m_unlisted.erase(unlisted);
+            insertAccessPoint(dbusObjPath, ap);
+            continue;
+        }
+
+        // With an ObjectManager the properties arrive with InterfacesAdded, and until
+        // GetManagedObjects has answered we do not know yet which path to take. An
+        // exclusive tracker fetches what its device lists but nobody announced yet.
+        // Suspended, only the active access point is fetched.
+        if ((m_suspended && dbusObjPath != m_priorityPath)
+                || m_objectManagerState == ObjectManagerState::Unknown
+                || (m_objectManagerState == ObjectManagerState::Available && !m_exclusive)) {
+            continue;
+        }
+
+        // A repeated request joins the call on the bus
+        if (m_fetchesInFlight.contains(dbusObjPath)) {
+            m_metrics->increment(BackendMetrics::FetchesJoined);
+        } else {
+            fetchQueue.insert(dbusObjPath);
+        }
+    }
+
+    // Paths which are not listed anymore are dropped from the queue, and their replies discarded
+    for (auto it = m_fetchesInFlight.begin(); it != m_fetchesInFlight.end(); ) {
+        if (isListed(it.key())) {
+            ++it;
+        } else {
+            it = m_fetchesInFlight.erase(it);
+        }
+    }
+    m_fetchQueue = fetchQueue;
+    m_fetchCursor = 0;
+    fetchNextAccessPoints();
+
+    // Remove unexisting access points. With an ObjectManager InterfacesRemoved does this,
+    // and an AP announced by InterfacesAdded may not be part of WiFiAccessPoints yet.
+    if (m_objectManagerState == ObjectManagerState::Available && !m_exclusive) {
+        return;
+    }
+
+    const QVector<QString> removedPaths = m_store.unorderedPaths();
+    for (const QString &dbusObjPath : removedPaths) {
+        // Still exists, it may be another device's or be listed again
+        const bool keep = m_objectManagerState == ObjectManagerState::Available && !m_stalePaths.contains(dbusObjPath);
+        const AccessPoint ap = m_store.accessPoint(m_store.pathId(dbusObjPath));
+        removeAccessPoint(dbusObjPath);
+        if (keep) {
+            m_unlisted.insert(dbusObjPath, ap);
+        }
+    }
+}
+
+
+void AccessPointTracker::setVisiblePaths(const QStringList &paths)
+{
+    m_visiblePaths = paths;
+    fetchNextAccessPoints();
+}
+
+
+void AccessPointTracker::setPriorityPath(const QString &dbusObjPath)
+{
+    m_priorityPath = dbusObjPath;
+    if (m_suspended) {
+        if (m_connection.isConnected())
+            watchPath(m_priorityPath);
+        // Not queued while suspended unless it is the active one
+        m_listUpdateScheduler->schedule();
+        return;
+    }
+    fetchNextAccessPoints();
+}
+
+
+void AccessPointTracker::fetchNextAccessPoints()
+{
+    while (m_fetchesInFlight.count() < maxFetchesInFlight && !m_fetchQueue.isEmpty()) {
+        const QString dbusObjPath = nextFetch();
+        m_fetchQueue.remove(dbusObjPath);
+        fetchAccessPoint(dbusObjPath);
+    }
+}
+
+
+QString AccessPointTracker::nextFetch()
+{
+    if (!m_priorityPath.isEmpty() && m_fetchQueue.contains(m_priorityPath)) {
+        return m_priorityPath;
+    }
+
+    // What the views show, in the order they passed it
+    for (const QString &dbusObjPath : qAsConst(m_visiblePaths)) {
+        if (m_fetchQueue.contains(dbusObjPath)) {
+            return dbusObjPath;
+        }
+    }
+
+    // The rest in list order, the cursor only moves forward until the list changes
+    const QVector<AccessPointStore::PathId> &order = m_store.order();
+    for (; m_fetchCursor < order.count(); ++m_fetchCursor) {
+        const QString &dbusObjPath = m_store.objectPath(order.at(m_fetchCursor));
+        if (m_fetchQueue.contains(dbusObjPath)) {
+            return dbusObjPath;
+        }
+    }
+
+    return *m_fetchQueue.constBegin();
+}
+
+
+void AccessPointTracker::fetchAccessPoint(const QString &dbusObjPath)
+{
+    QDBusMessage dbusMessageRequestProperties =
+        QDBusMessage::createMethodCall(connectivityDBusService, dbusObjPath, dbusPropertyInterface, "GetAll" );
+    QVariantList args;
+    args.append(QVariant::fromValue( accessPointDBusInterface ));
+    dbusMessageRequestProperties.setArguments(args);
+
+    const quint64 generation = m_listGeneration;
+    m_fetchesInFlight.insert(dbusObjPath, generation);
+
+    QElapsedTimer callTimer;
+    callTimer.start();
+    QDBusPendingCall pendingCall = m_connection.asyncCall(dbusMessageRequestProperties, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, dbusObjPath, generation, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::GetAll, callTimer.nsecsElapsed());
+                watcher->deleteLater();
+
+                // The path left the list, or the manager restarted, since the call was made
+                const auto inFlight = m_fetchesInFlight.find(dbusObjPath);
+                if (inFlight == m_fetchesInFlight.end() || inFlight.value() != generation) {
+                    m_metrics->increment(BackendMetrics::StaleRepliesDropped);
+                    return;
+                }
+                m_fetchesInFlight.erase(inFlight);
+
+                QDBusPendingReply<void> reply = *watcher;
+                if (reply.isError()) {
+                    qWarning() << Q_FUNC_INFO << reply.error().message();
+                } else {
+                    QDBusMessage message = reply.reply();
+                    const QDBusArgument arg = message.arguments().first().value<QDBusArgument>();
+                    AccessPoint ap;
+                    AccessPointDecoder::decode(arg, &ap);
+                    insertAccessPoint(dbusObjPath, ap);
+                }
+
+                fetchNextAccessPoints();
+            });
+}
+
+
+void AccessPointTracker::fetchManagedObjects()
+{
+    QDBusMessage dbusMessageRequestObjects =
+        QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, dbusObjectManagerInterface, "GetManagedObjects" );
+
+    QElapsedTimer callTimer;
+    callTimer.start();
+    const quint64 generation = m_generation;
+    QDBusPendingCall pendingCall = m_connection.asyncCall(dbusMessageRequestObjects, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, callTimer, generation](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::GetManagedObjects, callTimer.nsecsElapsed());
+                QDBusPendingReply<void> reply = *watcher;
+
+                // Answered, or failed, by an instance of the manager which is gone by now
+                if (generation != m_generation) {
+                    watcher->deleteLater();
+                    return;
+                }
+                m_resyncPending = false;
+
+                if (reply.isError()) {
+                    qWarning() << Q_FUNC_INFO << "ObjectManager not available, fetching access points one by one:"
+                               << reply.error().message();
+                    m_objectManagerState = ObjectManagerState::Unavailable;
+                    // Further devices are only exported through the ObjectManager
+                    if (m_reportDevices) {
+                        emit devicesFound(DeviceAccessPoints());
+                    }
+                    updateAccessPoints();
+                    m_publishScheduler->schedule();
+                    watcher->deleteLater();
+                    return;
+                }
+
+                m_objectManagerState = ObjectManagerState::Available;
+
+                // a{oa{sa{sv}}}. The access points are only handed out once all devices are known,
+                // which may be listed after their access points.
+                QHash<QString, AccessPoint> accessPoints;
+                QHash<QString, QList<QDBusObjectPath> > devicePaths;
+                QDBusMessage message = reply.reply();
+                const QDBusArgument arg = message.arguments().first().value<QDBusArgument>();
+                arg.beginMap();
+                while (!arg.atEnd()) {
+                    arg.beginMapEntry();
+                    QDBusObjectPath path;
+                    arg >> path;
+                    arg.beginMap();
+                    while (!arg.atEnd()) {
+                        arg.beginMapEntry();
+                        QString interfaceName;
+                        arg >> interfaceName;
+                        if (interfaceName == accessPointDBusInterface) {
+                            AccessPoint ap;
+                            AccessPointDecoder::decode(arg, &ap);
+                            accessPoints.insert(path.path(), ap);
+                        } else if (interfaceName == wifiDeviceDBusInterface && m_reportDevices) {
+                            devicePaths.insert(path.path(), accessPointPaths(arg));
+                        } else {
+                            QVariantMap ignored;
+                            arg >> ignored;
+                        }
+                        arg.endMapEntry();
+                    }
+                    arg.endMap();
+                    arg.endMapEntry();
+                }
+                arg.endMap();
+
+                // Every device gets its share of the reply, the rest is ours. Exclusive right away,
+                // so that the access points of other devices are never published here first.
+                DeviceAccessPoints devices;
+                for (auto it = devicePaths.constBegin(); it != devicePaths.constEnd(); ++it) {
+                    AccessPointSnapshot &share = devices[it.key()];
+                    for (const QDBusObjectPath &apPath : it.value()) {
+                        share.entries.append({ apPath.path(), accessPoints.take(apPath.path()) });
+                    }
+                }
+                if (!devices.isEmpty()) {
+                    m_exclusive = true;
+                }
+
+                for (auto it = accessPoints.constBegin(); it != accessPoints.constEnd(); ++it) {
+                    insertAccessPoint(it.key(), it.value());
+                }
+
+                if (m_reportDevices) {
+                    emit devicesFound(devices);
+                }
+
+                removeStalePaths();
+                // Listed paths nobody announced are fetched one by one now
+                m_listUpdateScheduler->schedule();
+                m_publishScheduler->schedule();
+
+                watcher->deleteLater();
+            });
+}
+
+
+void AccessPointTracker::insertAccessPoint(const QString &dbusObjPath, const AccessPoint &ap)
+{
+    if (ap.ssid().isEmpty()) {
+        return;
+    }
+
+    if (m_exclusive && !isListed(dbusObjPath)) {
+        if (m_store.contains(dbusObjPath) || m_stalePaths.contains(dbusObjPath)) {
+            removeAccessPoint(dbusObjPath);
+        }
+        m_unlisted.insert(dbusObjPath, ap);
+        return;
+    }
+
+    const AccessPointStore::PathId id = m_store.insert(dbusObjPath, ap);
+    m_strengthFilter.reset(id, ap.strength(), m_clock.elapsed());
+    m_stalePaths.remove(dbusObjPath);
+    m_fetchQueue.remove(dbusObjPath);
+
+    m_publishScheduler->schedule();
+}
+
+
+void AccessPointTracker::removeAccessPoint(const QString &dbusObjPath)
+{
+    m_unlisted.remove(dbusObjPath);
+    m_fetchQueue.remove(dbusObjPath);
+    // A freed slot goes to the next path in the queue
+    if (m_fetchesInFlight.remove(dbusObjPath)) {
+        fetchNextAccessPoints();
+    }
+    const bool wasStale = m_stalePaths.remove(dbusObjPath);
+    m_strengthFilter.remove(m_store.pathId(dbusObjPath));
+    if (!m_store.remove(dbusObjPath) && !wasStale) {
+        return;
+    }
+
+    m_publishScheduler->schedule();
+}
+
+
+bool AccessPointTracker::isListed(const QString &dbusObjPath) const
+{
+    const AccessPointStore::PathId id = m_store.pathId(dbusObjPath);
+    return id != AccessPointStore::InvalidId && m_store.isOrdered(id);
+}
+
+
+void AccessPointTracker::removeStalePaths()
+{
+    // Whatever is left from the snapshot does not exist anymore
+    const QSet<QString> stalePaths = m_stalePaths;
+    for (const QString &stalePath : stalePaths) {
+        removeAccessPoint(stalePath);
+    }
+}
+
+
+void AccessPointTracker::interfacesAddedHandler(const QDBusMessage &message)
+{
+    if (m_objectManagerState == ObjectManagerState::Unavailable) {
+        return;
+    }
+
+    const QVariantList arguments = message.arguments();
+    const QString objectPath = arguments.value(0).value<QDBusObjectPath>().path();
+
+    // a{sa{sv}}
+    const QDBusArgument argument1 = arguments.value(1).value<QDBusArgument>();
+    argument1.beginMap();
+    while (!argument1.atEnd()) {
+        argument1.beginMapEntry();
+        QString interfaceName;
+        argument1 >> interfaceName;
+        if (interfaceName == accessPointDBusInterface) {
+            AccessPoint ap;
+            AccessPointDecoder::decode(argument1, &ap);
+            insertAccessPoint(objectPath, ap);
+        } else {
+            if (interfaceName == wifiDeviceDBusInterface && m_reportDevices) {
+                emit deviceAdded(objectPath);
+            }
+            QVariantMap ignored;
+            argument1 >> ignored;
+        }
+        argument1.endMapEntry();
+    }
+    argument1.endMap();
+}
+
+
+void AccessPointTracker::interfacesRemovedHandler(const QDBusMessage &message)
+{
+    if (m_objectManagerState == ObjectManagerState::Unavailable) {
+        return;
+    }
+
+    const QVariantList arguments = message.arguments();
+    const QString objectPath = arguments.value(0).value<QDBusObjectPath>().path();
+    const QStringList interfaces = arguments.value(1).toStringList();
+
+    if (interfaces.contains(accessPointDBusInterface)) {
+        removeAccessPoint(objectPath);
+    }
+    if (interfaces.contains(wifiDeviceDBusInterface) && m_reportDevices) {
+        emit deviceRemoved(objectPath);
+    }
+}
+
+
+void AccessPointTracker::propertiesChangedHandler(const QDBusMessage &message)
+{
+    m_metrics->increment(BackendMetrics::PropertiesChangedReceived);
+
+    if (message.arguments().value(0) != accessPointDBusInterface) {
+        return;
+    }
+
+    // Someone else's, handed on to the trackers of the other devices
+    if (!applyPropertiesChanged(message) && m_reportDevices) {
+        emit propertiesChangedNotHandled(message);
+    }
+}
+
+
+void AccessPointTracker::routedPropertiesChanged(const QDBusMessage &message)
+{
+    // Counted as received by the tracker which has the match rule
+    applyPropertiesChanged(message);
+}
+
+
+bool AccessPointTracker::applyPropertiesChanged(const QDBusMessage &message)
+{
+    const QVariantList arguments = message.arguments();
+
+    // Nobody looks at the list, only the connection is followed. Resuming refreshes the rest.
+    const AccessPointDecoder::Fields fields = m_suspended ? AccessPointDecoder::Fields(AccessPointDecoder::ConnectedField)
+                                                          : AccessPointDecoder::Fields(AccessPointDecoder::AllFields);
+
+    const AccessPointStore::PathId id = m_store.pathId(message.path());
+    if ( !m_store.contains(id) ) {
+        // Not published, only kept current in case this device lists it later
+        const auto unlisted = m_unlisted.find(message.path());
+        if (unlisted != m_unlisted.end()) {
+            AccessPointDecoder::decode(arguments.value(1).value<QDBusArgument>(), &unlisted.value(), fields);
+        }
+        return false;
+    }
+
+    // Decoded into a copy, so that an absorbed strength change never touches the store
+    // and its revision
+    AccessPoint ap = m_store.accessPoint(id);
+    const int previousStrength = ap.strength();
+    const QDBusArgument argument1 = arguments.value(1).value<QDBusArgument>();
+    AccessPointDecoder::Fields changed = AccessPointDecoder::decode(argument1, &ap, fields);
+    m_metrics->increment(BackendMetrics::PropertiesChangedDecoded);
+
+    if (changed & AccessPointDecoder::StrengthField) {
+        if (!m_strengthFilter.accept(id, ap.strength(), m_clock.elapsed())) {
+            ap.setStrength(previousStrength);
+            changed &= ~AccessPointDecoder::Fields(AccessPointDecoder::StrengthField);
+            m_metrics->increment(BackendMetrics::StrengthUpdatesAbsorbed);
+            scheduleDeferredStrengths();
+        }
+    }
+
+    if (!changed) {
+        m_metrics->increment(BackendMetrics::PropertiesChangedSuppressed);
+        return true;
+    }
+
+    m_store.update(id, ap);
+    m_publishScheduler->schedule();
+    return true;
+}
+
+
+void AccessPointTracker::scheduleDeferredStrengths()
+{
+    const qint64 nextDue = m_strengthFilter.nextDue();
+    if (nextDue < 0) {
+        m_strengthTimer.stop();
+        return;
+    }
+
+    const int remaining = int(qMax<qint64>(0, nextDue - m_clock.elapsed()));
+    if (!m_strengthTimer.isActive() || m_strengthTimer.remainingTime() > remaining) {
+        m_strengthTimer.start(remaining);
+    }
+}
+
+
+void AccessPointTracker::applyDeferredStrengths()
+{
+    const QVector<StrengthFilter::Update> updates = m_strengthFilter.takeDue(m_clock.elapsed());
+    bool changed = false;
+    for (const StrengthFilter::Update &update : updates) {
+        if (m_store.contains(update.first) && m_store.accessPoint(update.first).strength() != update.second) {
+            m_store.setStrength(update.first, update.second);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        m_publishScheduler->schedule();
+    }
+    scheduleDeferredStrengths();
+}
@@ -0,0 +1,215 @@
+#ifndef CONNECTIVITY_ACCESSPOINTTRACKER_H_
+#define CONNECTIVITY_ACCESSPOINTTRACKER_H_
+
+#include <QObject>
+#include <QVariant>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+#include <memory>
+
+#include "accesspoint.h"
+#include "accesspointsnapshot.h"
+#include "accesspointstore.h"
+#include "backendmetrics.h"
+#include "strengthfilter.h"
+#include "updatescheduler.h"
+
+/*
+ * Immutable state of the access point list as published by AccessPointTracker.
+ * Everything the GUI needs is computed before publishing, readers only copy
+ * implicitly shared data out of it.
+ */
+struct AccessPointListSnapshot
+{
+    quint64 version = 0;
+    AccessPointStore store;
+    QVariantList accessPoints;  // store.toVariantList(), only rebuilt when store.revision() moved
+    QString connectedObjectPath;
+    bool stale = false;         // not confirmed by the live state yet, after a restore or a manager restart
+    quint64 generation = 0;     // resync() calls handled so far
+};
+
+typedef std::shared_ptr<const AccessPointListSnapshot> AccessPointListSnapshotPtr;
+
+// The access points of every WiFiDevice object in a GetManagedObjects reply, keyed by the
+// device path. Entries follow the device's WiFiAccessPoints, paths which were not part of
+// the reply have an access point without SSID.
+typedef QHash<QString, AccessPointSnapshot> DeviceAccessPoints;
+Q_DECLARE_METATYPE(DeviceAccessPoints)
+
+/*
+ * Keeps the access point store in sync with the connectivity manager: the
+ * ObjectManager bulk fetch and its InterfacesAdded/Removed signals, the per-AP
+ * GetAll fallback and the PropertiesChanged of every access point.
+ *
+ * The tracker may live in a thread of its own with a private bus connection,
+ * so that decoding never competes with rendering. Every state change results
+ * in a new snapshot which is swapped in atomically; published() tells the
+ * owner a newer version can be picked up with snapshot(), from any thread.
+ * Publishing without a visible change is a no-op, and a snapshot which only
+ * differs in its flags shares the list of its predecessor.
+ *
+ * When the manager restarts the list is kept and marked stale, and then
+ * reconciled with the state of the new instance instead of being rebuilt.
+ *
+ * With several WiFi devices every device has a tracker of its own. Such a
+ * tracker is exclusive: it only keeps the access points listed by its device
+ * and holds back the ones announced for other devices. Only the tracker which
+ * reports the devices calls GetManagedObjects; it splits the reply per device
+ * and the other trackers adopt() their share of it. It also holds the only
+ * match rule for the PropertiesChanged of the access points, and hands on the
+ * ones not in its own store.
+ *
+ * A suspended tracker drops the match rule for all access points and its
+ * fetch queue. It follows the active access point only, with a match rule for
+ * its path, and publishes nothing but changes of the connected access point.
+ * Resuming subscribes again and catches up with one bulk fetch, reconciled
+ * like after a restart of the manager; an access point connected by someone
+ * else in the meantime is learned then.
+ */
+class AccessPointTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AccessPointTracker(BackendMetrics *metrics, QObject *parent = nullptr);
+    ~AccessPointTracker();
+
+    AccessPointListSnapshotPtr snapshot() const { return std::atomic_load(&m_snapshot); }
+
+    // Seeds the store from a persisted snapshot, to be called before start()
+    void restore(const AccessPointSnapshot &snapshot);
+
+public Q_SLOTS:
+    // An empty connectionName shares the backend's connection, otherwise a private one is opened
+    void start(const QString &connectionName);
+    void setAccessPointPaths(const QList<QDBusObjectPath> &paths);
+    void setStrengthFilter(const QVariantList &thresholds, int hysteresis, int minInterval);
+    // Object paths of the rows the UI shows, whatever the model; their details are fetched first
+    void setVisiblePaths(const QStringList &paths);
+    // Fetched before anything else, the active access point
+    void setPriorityPath(const QString &dbusObjPath);
+    // Only keep the access points listed by setAccessPointPaths()
+    void setExclusive(bool exclusive);
+    // Report WiFiDevice objects found through the ObjectManager
+    void setReportDevices(bool reportDevices);
+    // resync() and resuming wait for adopt() instead of calling GetManagedObjects
+    void setBulkFetchShared(bool shared);
+    // No match rule for the access points, routedPropertiesChanged() hands their signals on.
+    // To be called before start().
+    void setPropertiesChangedRouted(bool routed);
+    // A PropertiesChanged the reporting tracker did not handle itself
+    void routedPropertiesChanged(const QDBusMessage &message);
+    // This device's share of the reporting tracker's GetManagedObjects reply. Before start()
+    // it replaces the initial bulk fetch, afterwards it reconciles like the reply of a resync.
+    void adopt(const AccessPointSnapshot &accessPoints);
+    // The manager left the bus, its access points are only kept until resync()
+    void serviceLost();
+    // A new instance of the manager owns the name
+    void resync();
+    // Nobody looks at the list: no per-AP subscriptions, fetches or list maintenance
+    void setSuspended(bool suspended);
+
+Q_SIGNALS:
+    void published(quint64 version);
+    // The devices of a GetManagedObjects reply with their access points, and the ones
+    // announced or removed afterwards
+    void devicesFound(const DeviceAccessPoints &devices);
+    void deviceAdded(const QString &objectPath);
+    // PropertiesChanged of an access point which is not in the store of the reporting tracker
+    void propertiesChangedNotHandled(const QDBusMessage &message);
+    void deviceRemoved(const QString &objectPath);
+
+private Q_SLOTS:
+    void propertiesChangedHandler(const QDBusMessage &message);
+    void interfacesAddedHandler(const QDBusMessage &message);
+    void interfacesRemovedHandler(const QDBusMessage &message);
+    void applyDeferredStrengths();
+
+private:
+    void subscribe();
+    void unsubscribe();
+    void subscribeAccessPoints();
+    void unsubscribeAccessPoints();
+    void watchPath(const QString &dbusObjPath);
+    void publish();
+    void updateAccessPoints();
+    void fetchManagedObjects();
+    void fetchNextAccessPoints();
+    QString nextFetch();
+    void fetchAccessPoint(const QString &dbusObjPath);
+    void insertAccessPoint(const QString &dbusObjPath, const AccessPoint &ap);
+    void removeAccessPoint(const QString &dbusObjPath);
+    bool isListed(const QString &dbusObjPath) const;
+    void removeStalePaths();
+    // Returns whether the access point is in the store, held back ones are only kept current
+    bool applyPropertiesChanged(const QDBusMessage &message);
+    void scheduleDeferredStrengths();
+
+    BackendMetrics *m_metrics = nullptr;
+
+    QDBusConnection m_connection;
+    QString m_connectionName;
+
+    AccessPointStore m_store;
+
+    // Strength jitter stays here, only bucket changes are published
+    StrengthFilter m_strengthFilter;
+    QElapsedTimer m_clock;
+    QTimer m_strengthTimer;
+
+    // Paths restored from the persisted snapshot that live D-Bus state has not confirmed yet
+    QSet<QString> m_stalePaths;
+    // Access points without properties yet. Their GetAll calls are prioritized: the active
+    // access point, then the visible paths, then the rest in list order, with a cap on the
+    // number of calls in flight.
+    QSet<QString> m_fetchQueue;
+    // The list generation each outstanding GetAll was issued in, per path. A path that
+    // leaves the list is dropped here, so its reply is discarded undecoded even if the
+    // path is listed and fetched again in the meantime.
+    QHash<QString, quint64> m_fetchesInFlight;
+    quint64 m_listGeneration = 0;
+    QString m_priorityPath;
+    QStringList m_visiblePaths;
+    int m_fetchCursor = 0;
+
+    // Exclusive trackers: access points announced but not listed by this device, kept up to
+    // date until their device turns out to be this one or they are removed
+    bool m_exclusive = false;
+    QHash<QString, AccessPoint> m_unlisted;
+    bool m_reportDevices = false;
+    bool m_bulkFetchShared = false;
+    bool m_propertiesChangedRouted = false;
+    bool m_adopted = false;
+
+    // While suspended only m_watchedPath is subscribed to, only its Connected property is
+    // decoded and only changes of the connected access point are published
+    bool m_suspended = false;
+    QString m_watchedPath;
+
+    // GetManagedObjects of the current generation did not answer yet
+    bool m_resyncPending = false;
+    quint64 m_generation = 0;
+
+    // Whether the manager exports org.freedesktop.DBus.ObjectManager. While unknown
+    // no per-AP GetAll is issued, the bulk GetManagedObjects reply is awaited instead.
+    enum class ObjectManagerState { Unknown, Available, Unavailable };
+    ObjectManagerState m_objectManagerState = ObjectManagerState::Unknown;
+
+    // The diff of WiFiAccessPoints against the store, and the snapshot publishing
+    UpdateScheduler *m_listUpdateScheduler = nullptr;
+    UpdateScheduler *m_publishScheduler = nullptr;
+
+    quint64 m_version = 0;
+    AccessPointListSnapshotPtr m_snapshot;
+};
+
+#endif // CONNECTIVITY_ACCESSPOINTTRACKER_H_
@@ -0,0 +1,276 @@
+#include "accesspointviewmodel.h"
+
+#include <algorithm>
+
+AccessPointViewModel::AccessPointViewModel(AccessPointModel *source, SortOrder sortOrder, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_source(source)
+    , m_sortOrder(sortOrder)
+{
+    QObject::connect(m_source, &QAbstractItemModel::rowsInserted, this, &AccessPointViewModel::sourceRowsInserted);
+    QObject::connect(m_source, &QAbstractItemModel::rowsAboutToBeRemoved, this, &AccessPointViewModel::sourceRowsAboutToBeRemoved);
+    QObject::connect(m_source, &QAbstractItemModel::dataChanged, this, &AccessPointViewModel::sourceDataChanged);
+    QObject::connect(m_source, &QAbstractItemModel::modelReset, this, &AccessPointViewModel::rebuild);
+
+    rebuild();
+}
+
+
+int AccessPointViewModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_visibleCount;
+}
+
+
+QVariant AccessPointViewModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_visibleCount)
+        return QVariant();
+
+    const Row &row = m_rows.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case AccessPointModel::SsidRole:
+        return row.accessPoint.ssid();
+    case AccessPointModel::ConnectedRole:
+        return row.accessPoint.connected();
+    case AccessPointModel::StrengthRole:
+        return row.accessPoint.strength();
+    case AccessPointModel::SecurityRole:
+        return QVariant::fromValue(row.accessPoint.security());
+    case AccessPointModel::ObjectPathRole:
+        return row.objectPath;
+    }
+    return QVariant();
+}
+
+
+QHash<int, QByteArray> AccessPointViewModel::roleNames() const
+{
+    return m_source->roleNames();
+}
+
+
+void AccessPointViewModel::setSortOrder(SortOrder sortOrder)
+{
+    if (m_sortOrder == sortOrder)
+        return;
+    m_sortOrder = sortOrder;
+    rebuild();
+    emit sortOrderChanged(m_sortOrder);
+}
+
+
+void AccessPointViewModel::setLimit(int limit)
+{
+    limit = qMax(0, limit);
+    if (m_limit == limit)
+        return;
+    m_limit = limit;
+    rebuild();
+    emit limitChanged(m_limit);
+}
+
+
+void AccessPointViewModel::setKnownSsids(const QStringList &knownSsids)
+{
+    if (m_knownSsids == knownSsids)
+        return;
+    m_knownSsids = knownSsids;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    m_knownSsidSet = QSet<QString>(knownSsids.begin(), knownSsids.end());
+#else
+    m_knownSsidSet = knownSsids.toSet();
+#endif
+    rebuild();
+    emit knownSsidsChanged(m_knownSsids);
+}
+
+
+void AccessPointViewModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    for (int row = first; row <= last; ++row) {
+        const Row inserted = sourceRow(row);
+        if (m_rowsByPath.contains(inserted.objectPath)) {
+            updateRow(inserted, QVector<int>());
+            continue;
+        }
+        m_rowsByPath.insert(inserted.objectPath, inserted);
+        insertAt(lowerBound(inserted), inserted);
+    }
+}
+
+
+void AccessPointViewModel::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    for (int row = first; row <= last; ++row) {
+        const auto it = m_rowsByPath.constFind(m_source->objectPath(row));
+        if (it == m_rowsByPath.constEnd())
+            continue;
+        const int position = lowerBound(*it);
+        m_rowsByPath.erase(it);
+        removeAt(position);
+    }
+}
+
+
+void AccessPointViewModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        updateRow(sourceRow(row), roles);
+}
+
+
+void AccessPointViewModel::rebuild()
+{
+    beginResetModel();
+
+    const int count = m_source->rowCount();
+    m_rows.clear();
+    m_rows.reserve(count);
+    m_rowsByPath.clear();
+    for (int row = 0; row < count; ++row) {
+        const Row current = sourceRow(row);
+        m_rows.append(current);
+        m_rowsByPath.insert(current.objectPath, current);
+    }
+    std::sort(m_rows.begin(), m_rows.end(),
+            [this](const Row &left, const Row &right) { return lessThan(left, right); });
+    m_visibleCount = m_limit > 0 ? qMin(m_limit, m_rows.count()) : m_rows.count();
+
+    endResetModel();
+}
+
+
+AccessPointViewModel::Row AccessPointViewModel::sourceRow(int row) const
+{
+    Row result;
+    result.objectPath = m_source->objectPath(row);
+    result.accessPoint = m_source->accessPoint(row);
+    result.known = m_knownSsidSet.contains(result.accessPoint.ssid());
+    return result;
+}
+
+
+bool AccessPointViewModel::lessThan(const Row &left, const Row &right) const
+{
+    const AccessPoint &l = left.accessPoint;
+    const AccessPoint &r = right.accessPoint;
+
+    if (m_sortOrder == ConnectedFirst) {
+        if (l.connected() != r.connected())
+            return l.connected();
+        if (left.known != right.known)
+            return left.known;
+    } else if (m_sortOrder == BySecurity) {
+        if (l.security() != r.security())
+            return l.security() < r.security();
+    }
+
+    if (l.strength() != r.strength())
+        return l.strength() > r.strength();
+    if (l.ssid() != r.ssid())
+        return l.ssid() < r.ssid();
+    return left.objectPath < right.objectPath;
+}
+
+
+int AccessPointViewModel::lowerBound(const Row &row) const
+{
+    const auto it = std::lower_bound(m_rows.constBegin(), m_rows.constEnd(), row,
+            [this](const Row &left, const Row &right) { return lessThan(left, right); });
+    return it - m_rows.constBegin();
+}
+
+
+void AccessPointViewModel::insertAt(int position, const Row &row)
+{
+    if (m_limit > 0 && position >= m_limit) {
+        m_rows.insert(position, row);
+        return;
+    }
+
+    // The last visible row is pushed out of the top-K
+    if (m_limit > 0 && m_visibleCount == m_limit) {
+        beginRemoveRows(QModelIndex(), m_visibleCount - 1, m_visibleCount - 1);
+        --m_visibleCount;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), position, position);
+    m_rows.insert(position, row);
+    ++m_visibleCount;
+    endInsertRows();
+}
+
+
+void AccessPointViewModel::removeAt(int position)
+{
+    if (position >= m_visibleCount) {
+        m_rows.remove(position);
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), position, position);
+    m_rows.remove(position);
+    --m_visibleCount;
+    endRemoveRows();
+
+    // The next one moves up into the top-K
+    if (m_limit > 0 && m_visibleCount < m_limit && m_rows.count() > m_visibleCount) {
+        beginInsertRows(QModelIndex(), m_visibleCount, m_visibleCount);
+        ++m_visibleCount;
+        endInsertRows();
+    }
+}
+
+
+void AccessPointViewModel::updateRow(const Row &row, const QVector<int> &roles)
+{
+    auto it = m_rowsByPath.find(row.objectPath);
+    if (it == m_rowsByPath.end())
+        return;
+
+    const int from = lowerBound(*it);
+    *it = row;
+
+    // Same place in the order: only the data changed
+    const bool before = from == 0 || lessThan(m_rows.at(from - 1), row);
+    const bool after = from == m_rows.count() - 1 || lessThan(row, m_rows.at(from + 1));
+    if (before && after) {
+        m_rows[from] = row;
+        if (from < m_visibleCount) {
+            const QModelIndex modelIndex = index(from);
+            emit dataChanged(modelIndex, modelIndex, roles);
+        }
+        return;
+    }
+
+    // Position among the other rows, i.e. with this one taken out
+    auto lessThanRow = [this](const Row &left, const Row &right) { return lessThan(left, right); };
+    int to = std::lower_bound(m_rows.constBegin(), m_rows.constEnd(), row, lessThanRow) - m_rows.constBegin();
+    if (to > from)
+        --to;
+
+    if (from < m_visibleCount && to < m_visibleCount) {
+        beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+        m_rows.remove(from);
+        m_rows.insert(to, row);
+        endMoveRows();
+        const QModelIndex modelIndex = index(to);
+        emit dataChanged(modelIndex, modelIndex, roles);
+        return;
+    }
+
+    // Entering or leaving the top-K
+    removeAt(from);
+    insertAt(to, row);
+}
@@ -0,0 +1,90 @@
+#ifndef CONNECTIVITY_ACCESSPOINTVIEWMODEL_H_
+#define CONNECTIVITY_ACCESSPOINTVIEWMODEL_H_
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include "accesspoint.h"
+#include "accesspointmodel.h"
+
+/*
+ * Sorted view of an AccessPointModel, optionally cut to the first limit rows.
+ *
+ * The view follows the row inserts, removals and dataChanged of its source and
+ * places every touched access point with a binary search, so a single strength
+ * change costs one move instead of a re-sort. The order of the source is
+ * irrelevant, ties are broken by SSID and object path.
+ */
+class AccessPointViewModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(SortOrder sortOrder READ sortOrder WRITE setSortOrder NOTIFY sortOrderChanged)
+    Q_PROPERTY(int limit READ limit WRITE setLimit NOTIFY limitChanged)
+    Q_PROPERTY(QStringList knownSsids READ knownSsids WRITE setKnownSsids NOTIFY knownSsidsChanged)
+
+public:
+    enum SortOrder {
+        ByStrength,         // strongest first
+        BySecurity,         // grouped by security type, strongest first within a group
+        ConnectedFirst      // the connected one, then known SSIDs, then by strength
+    };
+    Q_ENUM(SortOrder)
+
+    explicit AccessPointViewModel(AccessPointModel *source, SortOrder sortOrder = ByStrength, QObject *parent = nullptr);
+    ~AccessPointViewModel() = default;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    SortOrder sortOrder() const { return m_sortOrder; }
+    int limit() const { return m_limit; }
+    QStringList knownSsids() const { return m_knownSsids; }
+
+public Q_SLOTS:
+    void setSortOrder(SortOrder sortOrder);
+    void setLimit(int limit);
+    void setKnownSsids(const QStringList &knownSsids);
+
+Q_SIGNALS:
+    void sortOrderChanged(SortOrder sortOrder);
+    void limitChanged(int limit);
+    void knownSsidsChanged(const QStringList &knownSsids);
+
+private Q_SLOTS:
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void rebuild();
+
+private:
+    struct Row
+    {
+        QString objectPath;
+        AccessPoint accessPoint;
+        bool known = false;
+    };
+
+    Row sourceRow(int row) const;
+    bool lessThan(const Row &left, const Row &right) const;
+    int lowerBound(const Row &row) const;
+
+    void insertAt(int position, const Row &row);
+    void removeAt(int position);
+    void updateRow(const Row &row, const QVector<int> &roles);
+
+    AccessPointModel *m_source = nullptr;
+    SortOrder m_sortOrder = ByStrength;
+    int m_limit = 0;    // 0 shows every row
+    QStringList m_knownSsids;
+    QSet<QString> m_knownSsidSet;
+
+    QVector<Row> m_rows;                // all access points in view order
+    QHash<QString, Row> m_rowsByPath;   // the sort key each path is currently placed with
+    int m_visibleCount = 0;             // rows announced to the views, at most m_limit
+};
+
+#endif // CONNECTIVITY_ACCESSPOINTVIEWMODEL_H_
@@ -0,0 +1,167 @@
+#include "backendmetrics.h"
+
+#include <QMetaEnum>
+#include <QTextStream>
+
+static const qint64 firstBucketNsecs = 250000;
+
+static QString keyName(const char *enumKey)
+{
+    QString key = QLatin1String(enumKey);
+    key[0] = key.at(0).toLower();
+    return key;
+}
+
+
+BackendMetrics::BackendMetrics(QObject *parent) : QObject(parent)
+    , m_propertyMap(new QQmlPropertyMap(this))
+{
+    m_refreshTimer.setInterval(1000);
+    m_refreshTimer.setSingleShot(true);
+    m_refreshTimer.setTimerType(Qt::CoarseTimer);
+    QObject::connect(&m_refreshTimer, &QTimer::timeout, this, &BackendMetrics::refresh);
+
+    refresh();
+}
+
+
+void BackendMetrics::recordLatency(Operation operation, qint64 nsecs)
+{
+    Histogram &histogram = m_histograms[operation];
+
+    int bucket = 0;
+    for (qint64 bound = firstBucketNsecs; nsecs >= bound && bucket < BucketCount - 1; bound *= 2)
+        ++bucket;
+
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.totalNsecs.fetch_add(nsecs, std::memory_order_relaxed);
+    qint64 max = histogram.maxNsecs.load(std::memory_order_relaxed);
+    while (nsecs > max && !histogram.maxNsecs.compare_exchange_weak(max, nsecs, std::memory_order_relaxed)) {
+    }
+
+    scheduleRefresh();
+}
+
+
+void BackendMetrics::increment(Counter counter, quint64 amount)
+{
+    m_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    scheduleRefresh();
+}
+
+
+void BackendMetrics::setGauge(Gauge gauge, qint64 value)
+{
+    if (m_gauges[gauge].exchange(value, std::memory_order_relaxed) == value)
+        return;
+    scheduleRefresh();
+}
+
+
+QString BackendMetrics::dump() const
+{
+    const QMetaEnum operations = QMetaEnum::fromType<Operation>();
+    const QMetaEnum counters = QMetaEnum::fromType<Counter>();
+    const QMetaEnum gauges = QMetaEnum::fromType<Gauge>();
+
+    QString text;
+    QTextStream out(&text);
+
+    auto ms = [](double value) { return QStringLiteral("%1").arg(value, 10, 'f', 3); };
+
+    out << "latency (ms)               count      mean       p50       p95       max\n";
+    for (int i = 0; i < OperationCount; ++i) {
+        const Histogram &histogram = m_histograms[i];
+        const quint64 count = histogram.count;
+        out << QString::fromLatin1(operations.valueToKey(i)).leftJustified(22)
+            << QStringLiteral("%1").arg(count, 10)
+            << ms(count ? histogram.totalNsecs / 1e6 / count : 0.0)
+            << ms(histogram.percentileMs(0.50))
+            << ms(histogram.percentileMs(0.95))
+            << ms(histogram.maxNsecs / 1e6)
+            << "\n";
+    }
+    for (int i = 0; i < CounterCount; ++i)
+        out << counters.valueToKey(i) << ": " << quint64(m_counters[i]) << "\n";
+    for (int i = 0; i < GaugeCount; ++i)
+        out << gauges.valueToKey(i) << ": " << qint64(m_gauges[i]) << "\n";
+
+    out.flush();
+    return text;
+}
+
+
+void BackendMetrics::refresh()
+{
+    m_refreshPending = false;
+
+    const QMetaEnum operations = QMetaEnum::fromType<Operation>();
+    const QMetaEnum counters = QMetaEnum::fromType<Counter>();
+    const QMetaEnum gauges = QMetaEnum::fromType<Gauge>();
+
+    for (int i = 0; i < OperationCount; ++i) {
+        const Histogram &histogram = m_histograms[i];
+        const QString key = keyName(operations.valueToKey(i));
+        const quint64 count = histogram.count;
+        m_propertyMap->insert(key + QLatin1String("Count"), count);
+        m_propertyMap->insert(key + QLatin1String("MeanMs"), count ? histogram.totalNsecs / 1e6 / count : 0.0);
+        m_propertyMap->insert(key + QLatin1String("P50Ms"), histogram.percentileMs(0.50));
+        m_propertyMap->insert(key + QLatin1String("P95Ms"), histogram.percentileMs(0.95));
+        m_propertyMap->insert(key + QLatin1String("MaxMs"), histogram.maxNsecs / 1e6);
+    }
+    for (int i = 0; i < CounterCount; ++i)
+        m_propertyMap->insert(keyName(counters.valueToKey(i)), quint64(m_counters[i]));
+    for (int i = 0; i < GaugeCount; ++i)
+        m_propertyMap->insert(keyName(gauges.valueToKey(i)), qint64(m_gauges[i]));
+}
+
+
+void BackendMetrics::reset()
+{
+    for (Histogram &histogram : m_histograms) {
+        for (std::atomic<quint64> &bucket : histogram.buckets)
+            bucket = 0;
+        histogram.count = 0;
+        histogram.totalNsecs = 0;
+        histogram.maxNsecs = 0;
+    }
+    for (std::atomic<quint64> &counter : m_counters)
+        counter = 0;
+    refresh();
+}
+
+
+void BackendMetrics::scheduleRefresh()
+{
+    // The timer belongs to our thread, recorders elsewhere only post one request per refresh
+    if (m_refreshPending.exchange(true))
+        return;
+    QMetaObject::invokeMethod(this, "startRefreshTimer", Qt::QueuedConnection);
+}
+
+
+void BackendMetrics::startRefreshTimer()
+{
+    if (!m_refreshTimer.isActive())
+        m_refreshTimer.start();
+}
+
+
+double BackendMetrics::Histogram::percentileMs(double p) const
+{
+    const quint64 total = count;
+    if (total == 0)
+        return 0;
+
+    // Upper bound of the bucket holding the percentile, capped by the real maximum
+    const quint64 rank = quint64(p * total + 0.5);
+    quint64 seen = 0;
+    qint64 bound = firstBucketNsecs;
+    for (int i = 0; i < BucketCount; ++i, bound *= 2) {
+        seen += buckets[i];
+        if (seen >= rank && seen > 0)
+            return qMin(bound, qint64(maxNsecs)) / 1e6;
+    }
+    return maxNsecs / 1e6;
+}
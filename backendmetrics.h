@@ -0,0 +1,109 @@
+#ifndef CONNECTIVITY_BACKENDMETRICS_H_
+#define CONNECTIVITY_BACKENDMETRICS_H_
+
+#include <QObject>
+#include <QQmlPropertyMap>
+#include <QTimer>
+
+#include <atomic>
+
+/*
+ * Runtime metrics of the WiFi backend: latency histograms of the D-Bus calls,
+ * message and notification counters, and a few gauges.
+ *
+ * Recording is cheap and may happen from any thread, the QML-readable property
+ * map is refreshed in the object's own thread at most once per second and only
+ * while something changed. dump() renders everything as text, e.g. for logging
+ * on target hardware.
+ */
+class BackendMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        Get,
+        GetAll,
+        GetManagedObjects,
+        Set,
+        Connect,
+        Disconnect,
+        // phases of a connection attempt
+        Association,
+        Credentials,
+        AddressConfiguration,
+        TimeToConnect,
+        // from the manager reappearing on the bus until its state was resynchronized
+        Recovery,
+        OperationCount
+    };
+    Q_ENUM(Operation)
+
+    enum Counter {
+        PropertiesChangedReceived,
+        PropertiesChangedDecoded,
+        PropertiesChangedSuppressed,
+        StrengthUpdatesAbsorbed,
+        AccessPointsChangedEmitted,
+        ModelRowsChanged,
+        ManagerRestarts,
+        FetchesJoined,
+        StaleRepliesDropped,
+        CounterCount
+    };
+    Q_ENUM(Counter)
+
+    enum Gauge {
+        StoreSize,
+        TimeToFirstState,
+        GaugeCount
+    };
+    Q_ENUM(Gauge)
+
+    explicit BackendMetrics(QObject *parent = nullptr);
+    ~BackendMetrics() = default;
+
+    void recordLatency(Operation operation, qint64 nsecs);
+    void increment(Counter counter, quint64 amount = 1);
+    void setGauge(Gauge gauge, qint64 value);
+
+    quint64 counter(Counter counter) const { return m_counters[counter].load(std::memory_order_relaxed); }
+    qint64 gauge(Gauge gauge) const { return m_gauges[gauge].load(std::memory_order_relaxed); }
+
+    QQmlPropertyMap *propertyMap() const { return m_propertyMap; }
+    QString dump() const;
+
+public Q_SLOTS:
+    void refresh();
+    void reset();
+
+private:
+    // Bucket i counts latencies below 250us * 2^i, the last one everything above
+    static const int BucketCount = 16;
+
+    struct Histogram
+    {
+        std::atomic<quint64> buckets[BucketCount] = {};
+        std::atomic<quint64> count = {0};
+        std::atomic<qint64> totalNsecs = {0};
+        std::atomic<qint64> maxNsecs = {0};
+
+        double percentileMs(double p) const;
+    };
+
+    void scheduleRefresh();
+
+private Q_SLOTS:
+    void startRefreshTimer();
+
+private:
+    Histogram m_histograms[OperationCount];
+    std::atomic<quint64> m_counters[CounterCount] = {};
+    std::atomic<qint64> m_gauges[GaugeCount] = {};
+
+    QQmlPropertyMap *m_propertyMap = nullptr;
+    QTimer m_refreshTimer;
+    std::atomic<bool> m_refreshPending = {false};
+};
+
+#endif // CONNECTIVITY_BACKENDMETRICS_H_
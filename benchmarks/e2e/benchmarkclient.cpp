@@ -0,0 +1,237 @@
+#include "benchmarkclient.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusReply>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "fakeconnectivitymanager.h"
+
+// Time on top of the strength update interval after which a change no signal followed is absorbed
+static const int absorbedTickSlackMs = 250;
+
+static double percentile(const QVector<double> &sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    const int index = qBound(0, int(p * (sorted.count() - 1) + 0.5), sorted.count() - 1);
+    return sorted.at(index);
+}
+
+
+BenchmarkClient::BenchmarkClient(int expectedAccessPoints, int duration, const QString &stateDirectory,
+        QObject *parent)
+    : QObject(parent)
+    , m_expectedAccessPoints(expectedAccessPoints)
+    , m_duration(duration)
+{
+    // Never read or overwrite the snapshot and the credentials of the user running the benchmark
+    const QString snapshotFileName = QDir(stateDirectory).filePath(QStringLiteral("accesspoints.snapshot"));
+    m_warmStart = QFile::exists(snapshotFileName);
+    m_backend.setSnapshotFileName(snapshotFileName);
+    m_backend.setCredentialStore(nullptr);
+
+    QObject::connect(&m_backend, &WiFiBackend::accessPointsChanged, this, [this](const QVariantList &accessPoints) {
+        ++m_accessPointsChanged;
+        uiSignal();
+        if (!m_listComplete && accessPoints.count() >= m_expectedAccessPoints)
+            listComplete();
+    });
+
+    // Single row updates reach QML through the model without a list re-emission, and the
+    // rows they touch tell which change became visible
+    AccessPointModel *model = m_backend.accessPointModel();
+    QObject::connect(model, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                uiSignal();
+                rowsChanged(topLeft.row(), bottomRight.row());
+            });
+    QObject::connect(model, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int first, int last) {
+        uiSignal();
+        rowsChanged(first, last);
+    });
+    QObject::connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) { rowsChanged(first, last); });
+    QObject::connect(model, &QAbstractItemModel::rowsRemoved, this, [this]() { uiSignal(); });
+
+    m_durationTimer.setSingleShot(true);
+    QObject::connect(&m_durationTimer, &QTimer::timeout, this, &BenchmarkClient::finish);
+
+    QObject::connect(&m_heapTimer, &QTimer::timeout, this, &BenchmarkClient::sampleHeap);
+}
+
+
+void BenchmarkClient::start()
+{
+    WiFiBackend::dbusConnection().connect(connectivityDBusService, connectivityDBusPath, benchDBusInterface,
+            QStringLiteral("Tick"), this, SLOT(tickReceived(qlonglong,qulonglong,QString)));
+
+    // Give up if the fake never delivers the full list
+    QTimer::singleShot(30000, this, [this]() {
+        if (!m_listComplete)
+            finish();
+    });
+
+    // A priming run may have used the fake before
+    m_statsAtLaunch = fakeStats();
+
+    m_heapTimer.start(20);
+    m_clock.start();
+    m_backend.initialize();
+}
+
+
+void BenchmarkClient::tickReceived(qlonglong timestamp, qulonglong sequence, const QString &objectPath)
+{
+    dropAbsorbedTicks();
+    m_pendingTicks.append(PendingTick{sequence, objectPath, timestamp});
+}
+
+
+void BenchmarkClient::uiSignal()
+{
+    ++m_uiSignals;
+}
+
+
+void BenchmarkClient::rowsChanged(int first, int last)
+{
+    dropAbsorbedTicks();
+    if (m_pendingTicks.isEmpty())
+        return;
+
+    const AccessPointModel *model = m_backend.accessPointModel();
+    const qint64 now = monotonicNs();
+    for (int row = first; row <= last; ++row) {
+        const QString &objectPath = model->objectPath(row);
+
+        // The row shows the latest change of its access point; earlier ones it superseded
+        // were never visible on their own and count as absorbed
+        int latest = -1;
+        for (int i = 0; i < m_pendingTicks.count(); ++i) {
+            if (m_pendingTicks.at(i).objectPath != objectPath)
+                continue;
+            if (latest >= 0)
+                ++m_absorbedTicks;
+            latest = i;
+        }
+        if (latest < 0)
+            continue;
+
+        m_latencies.append((now - m_pendingTicks.at(latest).timestamp) / 1e6);
+        const quint64 sequence = m_pendingTicks.at(latest).sequence;
+        m_pendingTicks.erase(std::remove_if(m_pendingTicks.begin(), m_pendingTicks.end(),
+                [&](const PendingTick &tick) { return tick.objectPath == objectPath && tick.sequence <= sequence; }),
+                m_pendingTicks.end());
+    }
+}
+
+
+void BenchmarkClient::dropAbsorbedTicks()
+{
+    // Changes the strength filter holds back show up within its update interval, so one
+    // that no signal followed by then was dropped by the filter
+    const qint64 window = (m_backend.strengthUpdateInterval() + absorbedTickSlackMs) * 1000000LL;
+    const qint64 now = monotonicNs();
+    int expired = 0;
+    while (expired < m_pendingTicks.count() && now - m_pendingTicks.at(expired).timestamp > window)
+        ++expired;
+    m_pendingTicks.remove(0, expired);
+    m_absorbedTicks += expired;
+}
+
+
+void BenchmarkClient::listComplete()
+{
+    m_listComplete = true;
+    if (m_priming) {
+        emit finished(0);
+        return;
+    }
+    m_startupMs = m_clock.nsecsElapsed() / 1e6;
+    m_statsAtStart = fakeStats();
+    m_uiSignals = 0;
+    m_accessPointsChanged = 0;
+
+    QDBusMessage startMessage = QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath,
+            benchDBusInterface, QStringLiteral("Start"));
+    WiFiBackend::dbusConnection().asyncCall(startMessage);
+    m_durationTimer.start(m_duration);
+}
+
+
+void BenchmarkClient::finish()
+{
+    m_heapTimer.stop();
+    sampleHeap();
+    dropAbsorbedTicks();
+
+    const QVariantMap statsAtEnd = fakeStats();
+    auto delta = [&](const char *key) {
+        return statsAtEnd.value(QLatin1String(key)).toULongLong() - m_statsAtStart.value(QLatin1String(key)).toULongLong();
+    };
+    // Tick signals and the Start/Stats calls belong to the harness, not to the backend
+    const quint64 ticks = delta("ticks");
+    const quint64 busMessages = delta("methodCalls") + delta("signalsSent") - ticks - 2;
+    auto startupDelta = [&](const char *key) {
+        return m_statsAtStart.value(QLatin1String(key)).toULongLong() - m_statsAtLaunch.value(QLatin1String(key)).toULongLong();
+    };
+    const quint64 startupMessages = startupDelta("methodCalls") + startupDelta("signalsSent") - 1;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const double cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+
+    QVector<double> sorted = m_latencies;
+    std::sort(sorted.begin(), sorted.end());
+
+    QTextStream out(stdout);
+    out << "aps=" << m_expectedAccessPoints
+        << " start=" << (m_warmStart ? "warm" : "cold")
+        << " startup_ms=" << m_startupMs
+        << " startup_msgs=" << startupMessages
+        << " events=" << ticks
+        << " absorbed=" << m_absorbedTicks
+        << " ui_signals=" << m_uiSignals
+        << " list_emits=" << m_accessPointsChanged
+        << " latency_p50_ms=" << percentile(sorted, 0.50)
+        << " latency_p95_ms=" << percentile(sorted, 0.95)
+        << " latency_p99_ms=" << percentile(sorted, 0.99)
+        << " latency_max_ms=" << (sorted.isEmpty() ? 0 : sorted.last())
+        << " msgs_per_event=" << (ticks ? double(busMessages) / ticks : 0)
+        << " cpu_ms=" << cpuMs
+        << " peak_heap_kb=" << m_peakHeap / 1024
+        << " peak_rss_kb=" << usage.ru_maxrss
+        << '\n';
+    out.flush();
+
+    emit finished(m_listComplete ? 0 : 1);
+}
+
+
+void BenchmarkClient::sampleHeap()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+#else
+    const struct mallinfo info = mallinfo();
+#endif
+    m_peakHeap = qMax<qint64>(m_peakHeap, qint64(info.uordblks) + qint64(info.hblkhd));
+}
+
+
+QVariantMap BenchmarkClient::fakeStats() const
+{
+    QDBusMessage statsMessage = QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath,
+            benchDBusInterface, QStringLiteral("Stats"));
+    QDBusReply<QVariantMap> reply = WiFiBackend::dbusConnection().call(statsMessage);
+    return reply.value();
+}
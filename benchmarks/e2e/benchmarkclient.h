@@ -0,0 +1,73 @@
+#ifndef BENCHMARKS_BENCHMARKCLIENT_H_
+#define BENCHMARKS_BENCHMARKCLIENT_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+#include "wifibackend.h"
+
+/*
+ * Drives a WiFiBackend against the fake manager on the private bus and
+ * collects the numbers printed for one run.
+ */
+class BenchmarkClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchmarkClient(int expectedAccessPoints, int duration, const QString &stateDirectory, QObject *parent = nullptr);
+
+    // Stop as soon as the list is complete and only leave the snapshot behind
+    void setPriming(bool priming) { m_priming = priming; }
+
+    void start();
+
+Q_SIGNALS:
+    void finished(int exitCode);
+
+private Q_SLOTS:
+    void tickReceived(qlonglong timestamp, qulonglong sequence, const QString &objectPath);
+
+private:
+    struct PendingTick
+    {
+        quint64 sequence;
+        QString objectPath;
+        qint64 timestamp;
+    };
+
+    void uiSignal();
+    void rowsChanged(int first, int last);
+    void dropAbsorbedTicks();
+    void listComplete();
+    void finish();
+    void sampleHeap();
+    QVariantMap fakeStats() const;
+
+    int m_expectedAccessPoints;
+    int m_duration;
+    bool m_priming = false;
+    bool m_warmStart = false;
+
+    WiFiBackend m_backend;
+    QElapsedTimer m_clock;
+    QTimer m_durationTimer;
+    QTimer m_heapTimer;
+
+    bool m_listComplete = false;
+    double m_startupMs = -1;
+    QVariantMap m_statsAtLaunch;
+    QVariantMap m_statsAtStart;
+
+    QVector<PendingTick> m_pendingTicks;
+    quint64 m_absorbedTicks = 0;
+    QVector<double> m_latencies;
+    quint64 m_uiSignals = 0;
+    quint64 m_accessPointsChanged = 0;
+    qint64 m_peakHeap = 0;
+};
+
+#endif // BENCHMARKS_BENCHMARKCLIENT_H_
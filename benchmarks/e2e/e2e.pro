@@ -0,0 +1,25 @@
+TARGET = wifi_e2e_benchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += core ivicore dbus qml
+
+include($$SOURCE_DIR/config.pri)
+include(../../wifibackend.pri)
+
+LIBS += -L$$LIB_DESTDIR -l$$qtLibraryTarget(Connectivity)
+
+INCLUDEPATH += $$OUT_PWD/../../../connectivity
+
+SOURCES += main.cpp \
+           benchmarkclient.cpp \
+           fakeconnectivitymanager.cpp
+
+HEADERS += benchmarkclient.h \
+           fakeconnectivitymanager.h
+
+# make benchmark: 10, 100 and 1000 access points on a private bus
+benchmark.commands = $$OUT_PWD/$$TARGET --aps 10,100,1000
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
@@ -0,0 +1,394 @@
+#include "fakeconnectivitymanager.h"
+
+#include <QDBusArgument>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusVariant>
+#include <QDebug>
+
+#include "wifibackend.h"
+
+static const char *const securityTypes[] = { "none", "wep", "wpa-psk", "wpa-eap" };
+
+FakeConnectivityManager::FakeConnectivityManager(const QDBusConnection &connection, int accessPoints, QObject *parent)
+    : QDBusVirtualObject(parent)
+    , m_connection(connection)
+    , m_random(0x5eed)
+{
+    qDBusRegisterMetaType<InterfaceList>();
+    qDBusRegisterMetaType<ManagedObjectList>();
+
+    for (int i = 0; i < accessPoints; ++i) {
+        addAccessPoint();
+    }
+
+    m_phaseTimer.setSingleShot(true);
+    QObject::connect(&m_phaseTimer, &QTimer::timeout, this, [this]() { startPhase(m_phase + 1); });
+    QObject::connect(&m_jitterTimer, &QTimer::timeout, this, &FakeConnectivityManager::jitter);
+    QObject::connect(&m_churnTimer, &QTimer::timeout, this, &FakeConnectivityManager::churn);
+    QObject::connect(&m_connectTimer, &QTimer::timeout, this, &FakeConnectivityManager::toggleConnection);
+}
+
+
+bool FakeConnectivityManager::parseScript(const QString &script, QVector<ChurnPhase> *phases)
+{
+    const QStringList lines = script.split(QLatin1Char('\n'), skipEmptyParts);
+    for (const QString &line : lines) {
+        const QString trimmed = line.trimmed();
+        if (trimmed.isEmpty() || trimmed.startsWith(QLatin1Char('#')))
+            continue;
+
+        const QStringList fields = trimmed.split(QLatin1Char(' '), skipEmptyParts);
+        ChurnPhase phase;
+        bool ok = false;
+        phase.duration = fields.first().toInt(&ok);
+        if (!ok)
+            return false;
+
+        for (int i = 1; i < fields.count(); ++i) {
+            const QStringList pair = fields.at(i).split(QLatin1Char('='));
+            if (pair.count() != 2)
+                return false;
+            const double rate = pair.at(1).toDouble(&ok);
+            if (!ok)
+                return false;
+            if (pair.at(0) == QLatin1String("jitter"))
+                phase.jitterRate = rate;
+            else if (pair.at(0) == QLatin1String("churn"))
+                phase.churnRate = rate;
+            else if (pair.at(0) == QLatin1String("connect"))
+                phase.connectRate = rate;
+            else
+                return false;
+        }
+        phases->append(phase);
+    }
+    return true;
+}
+
+
+bool FakeConnectivityManager::registerService()
+{
+    if (!m_connection.registerVirtualObject(connectivityDBusPath, this, QDBusConnection::SubPath)) {
+        qWarning() << Q_FUNC_INFO << m_connection.lastError().message();
+        return false;
+    }
+    if (!m_connection.registerService(connectivityDBusService)) {
+        qWarning() << Q_FUNC_INFO << m_connection.lastError().message();
+        return false;
+    }
+    return true;
+}
+
+
+bool FakeConnectivityManager::handleMessage(const QDBusMessage &message, const QDBusConnection &connection)
+{
+    Q_UNUSED(connection)
+
+    if (message.type() != QDBusMessage::MethodCallMessage)
+        return false;
+
+    ++m_methodCalls;
+
+    const QString path = message.path();
+    const QString interface = message.interface();
+    const QString member = message.member();
+    const QVariantList arguments = message.arguments();
+    const bool isManager = (path == connectivityDBusPath);
+
+    if (interface == dbusPropertyInterface) {
+        const QString propertyInterface = arguments.value(0).toString();
+
+        if (member == QLatin1String("GetAll")) {
+            if (isManager && propertyInterface == connectivityDBusInterface) {
+                reply(message, QVariantList() << managerProperties());
+                return true;
+            }
+            if (m_accessPoints.contains(path) && propertyInterface == accessPointDBusInterface) {
+                reply(message, QVariantList() << accessPointProperties(path));
+                return true;
+            }
+        } else if (member == QLatin1String("Get")) {
+            const QVariantMap properties = isManager ? managerProperties() : accessPointProperties(path);
+            const QString name = arguments.value(1).toString();
+            if (properties.contains(name)) {
+                reply(message, QVariantList() << QVariant::fromValue(QDBusVariant(properties.value(name))));
+                return true;
+            }
+        } else if (member == QLatin1String("Set") && isManager) {
+            const QString name = arguments.value(1).toString();
+            const QVariant value = arguments.value(2).value<QDBusVariant>().variant();
+            if (name == QLatin1String("WiFiEnabled"))
+                m_wifiEnabled = value.toBool();
+            else if (name == QLatin1String("WiFiHotspotEnabled"))
+                m_hotspotEnabled = value.toBool();
+            else if (name == QLatin1String("WiFiHotspotSSID"))
+                m_hotspotSSID = value.toByteArray();
+            else if (name == QLatin1String("WiFiHotspotPassphrase"))
+                m_hotspotPassphrase = value.toString();
+            else
+                return false;
+            reply(message);
+            QVariantMap changed;
+            changed.insert(name, value);
+            emitPropertiesChanged(connectivityDBusPath, connectivityDBusInterface, changed);
+            return true;
+        }
+    } else if (interface == dbusObjectManagerInterface && isManager && member == QLatin1String("GetManagedObjects")) {
+        ManagedObjectList objects;
+        for (const QString &apPath : qAsConst(m_order)) {
+            InterfaceList interfaces;
+            interfaces.insert(accessPointDBusInterface, accessPointProperties(apPath));
+            objects.insert(QDBusObjectPath(apPath), interfaces);
+        }
+        reply(message, QVariantList() << QVariant::fromValue(objects));
+        return true;
+    } else if (interface == connectivityDBusInterface && isManager) {
+        const QString apPath = arguments.value(0).value<QDBusObjectPath>().path();
+        if (!m_accessPoints.contains(apPath)) {
+            send(message.createErrorReply(QDBusError::InvalidArgs, QStringLiteral("Unknown access point")));
+            return true;
+        }
+        if (member == QLatin1String("Connect")) {
+            reply(message);
+            setConnected(apPath, true);
+            return true;
+        }
+        if (member == QLatin1String("Disconnect")) {
+            reply(message);
+            setConnected(apPath, false);
+            return true;
+        }
+    } else if (interface == benchDBusInterface && isManager) {
+        if (member == QLatin1String("Start")) {
+            reply(message);
+            start();
+            return true;
+        }
+        if (member == QLatin1String("Stats")) {
+            QVariantMap stats;
+            stats.insert(QStringLiteral("methodCalls"), m_methodCalls);
+            stats.insert(QStringLiteral("signalsSent"), m_signalsSent);
+            stats.insert(QStringLiteral("ticks"), m_ticks);
+            stats.insert(QStringLiteral("accessPoints"), m_accessPoints.count());
+            reply(message, QVariantList() << stats);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+QString FakeConnectivityManager::introspect(const QString &path) const
+{
+    Q_UNUSED(path)
+    return QString();
+}
+
+
+void FakeConnectivityManager::start()
+{
+    if (m_phases.isEmpty())
+        return;
+    startPhase(0);
+}
+
+
+void FakeConnectivityManager::startPhase(int index)
+{
+    m_jitterTimer.stop();
+    m_churnTimer.stop();
+    m_connectTimer.stop();
+
+    m_phase = index;
+    if (index >= m_phases.count())
+        return;
+
+    const ChurnPhase &phase = m_phases.at(index);
+    auto startRate = [](QTimer &timer, double rate) {
+        if (rate > 0) {
+            timer.setTimerType(Qt::PreciseTimer);
+            timer.start(qMax(1, int(1000.0 / rate)));
+        }
+    };
+    startRate(m_jitterTimer, phase.jitterRate);
+    startRate(m_churnTimer, phase.churnRate);
+    startRate(m_connectTimer, phase.connectRate);
+    m_phaseTimer.start(phase.duration);
+}
+
+
+void FakeConnectivityManager::reply(const QDBusMessage &message, const QVariantList &arguments)
+{
+    QDBusMessage reply = message.createReply();
+    reply.setArguments(arguments);
+    send(reply);
+}
+
+
+void FakeConnectivityManager::addAccessPoint()
+{
+    const int id = m_nextId++;
+    const QString path = QStringLiteral("%1/AccessPoint%2").arg(connectivityDBusPath).arg(id);
+
+    FakeAccessPoint ap;
+    ap.ssid = QStringLiteral("bench-%1").arg(id);
+    ap.strength = int(m_random.bounded(100));
+    ap.security = QLatin1String(securityTypes[id % 4]);
+    m_accessPoints.insert(path, ap);
+    m_order.append(path);
+}
+
+
+void FakeConnectivityManager::removeAccessPoint(const QString &path)
+{
+    m_accessPoints.remove(path);
+    m_order.removeAll(path);
+
+    QDBusMessage removed = QDBusMessage::createSignal(connectivityDBusPath, dbusObjectManagerInterface, QStringLiteral("InterfacesRemoved"));
+    removed << QVariant::fromValue(QDBusObjectPath(path)) << QStringList(accessPointDBusInterface);
+    send(removed);
+}
+
+
+void FakeConnectivityManager::setConnected(const QString &path, bool connected)
+{
+    if (connected) {
+        for (auto it = m_accessPoints.begin(); it != m_accessPoints.end(); ++it) {
+            if (it.value().connected && it.key() != path) {
+                it.value().connected = false;
+                QVariantMap changed;
+                changed.insert(QStringLiteral("Connected"), false);
+                emitPropertiesChanged(it.key(), accessPointDBusInterface, changed);
+            }
+        }
+    }
+
+    FakeAccessPoint &ap = m_accessPoints[path];
+    if (ap.connected == connected)
+        return;
+    ap.connected = connected;
+
+    QVariantMap changed;
+    changed.insert(QStringLiteral("Connected"), connected);
+    emitPropertiesChanged(path, accessPointDBusInterface, changed);
+}
+
+
+void FakeConnectivityManager::jitter()
+{
+    const QString path = randomAccessPoint();
+    if (path.isEmpty())
+        return;
+
+    tick(path);
+    FakeAccessPoint &ap = m_accessPoints[path];
+    ap.strength = qBound(0, ap.strength + int(m_random.bounded(11)) - 5, 100);
+
+    QVariantMap changed;
+    changed.insert(QStringLiteral("Strength"), ap.strength);
+    emitPropertiesChanged(path, accessPointDBusInterface, changed);
+}
+
+
+void FakeConnectivityManager::churn()
+{
+    // One access point disappears, a new one shows up, which is the change the tick announces
+    const QString path = randomAccessPoint();
+    addAccessPoint();
+    const QString added = m_order.last();
+    tick(added);
+
+    if (!path.isEmpty())
+        removeAccessPoint(path);
+
+    InterfaceList interfaces;
+    interfaces.insert(accessPointDBusInterface, accessPointProperties(added));
+    QDBusMessage addedSignal = QDBusMessage::createSignal(connectivityDBusPath, dbusObjectManagerInterface, QStringLiteral("InterfacesAdded"));
+    addedSignal << QVariant::fromValue(QDBusObjectPath(added)) << QVariant::fromValue(interfaces);
+    send(addedSignal);
+
+    QVariantMap changed;
+    changed.insert(QStringLiteral("WiFiAccessPoints"), QVariant::fromValue(accessPointPaths()));
+    emitPropertiesChanged(connectivityDBusPath, connectivityDBusInterface, changed);
+}
+
+
+void FakeConnectivityManager::toggleConnection()
+{
+    const QString path = randomAccessPoint();
+    if (path.isEmpty())
+        return;
+
+    tick(path);
+    setConnected(path, !m_accessPoints.value(path).connected);
+}
+
+
+void FakeConnectivityManager::tick(const QString &path)
+{
+    ++m_ticks;
+    QDBusMessage tickSignal = QDBusMessage::createSignal(connectivityDBusPath, benchDBusInterface, QStringLiteral("Tick"));
+    tickSignal << monotonicNs() << qulonglong(m_ticks) << path;
+    send(tickSignal);
+}
+
+
+QVariantMap FakeConnectivityManager::managerProperties() const
+{
+    QVariantMap properties;
+    properties.insert(QStringLiteral("WiFiAvailable"), true);
+    properties.insert(QStringLiteral("WiFiEnabled"), m_wifiEnabled);
+    properties.insert(QStringLiteral("WiFiHotspotEnabled"), m_hotspotEnabled);
+    properties.insert(QStringLiteral("WiFiHotspotSSID"), m_hotspotSSID);
+    properties.insert(QStringLiteral("WiFiHotspotPassphrase"), m_hotspotPassphrase);
+    properties.insert(QStringLiteral("WiFiAccessPoints"), QVariant::fromValue(accessPointPaths()));
+    return properties;
+}
+
+
+QVariantMap FakeConnectivityManager::accessPointProperties(const QString &path) const
+{
+    const FakeAccessPoint ap = m_accessPoints.value(path);
+    QVariantMap properties;
+    properties.insert(QStringLiteral("SSID"), ap.ssid);
+    properties.insert(QStringLiteral("Connected"), ap.connected);
+    properties.insert(QStringLiteral("Strength"), ap.strength);
+    properties.insert(QStringLiteral("Security"), ap.security);
+    return properties;
+}
+
+
+QList<QDBusObjectPath> FakeConnectivityManager::accessPointPaths() const
+{
+    QList<QDBusObjectPath> paths;
+    paths.reserve(m_order.count());
+    for (const QString &path : m_order)
+        paths.append(QDBusObjectPath(path));
+    return paths;
+}
+
+
+QString FakeConnectivityManager::randomAccessPoint()
+{
+    if (m_order.isEmpty())
+        return QString();
+    return m_order.at(int(m_random.bounded(m_order.count())));
+}
+
+
+void FakeConnectivityManager::emitPropertiesChanged(const QString &path, const QString &interface, const QVariantMap &changed)
+{
+    QDBusMessage changedSignal = QDBusMessage::createSignal(path, dbusPropertyInterface, QStringLiteral("PropertiesChanged"));
+    changedSignal << interface << changed << QStringList();
+    send(changedSignal);
+}
+
+
+void FakeConnectivityManager::send(const QDBusMessage &message)
+{
+    if (message.type() == QDBusMessage::SignalMessage)
+        ++m_signalsSent;
+    m_connection.send(message);
+}
@@ -0,0 +1,128 @@
+#ifndef BENCHMARKS_FAKECONNECTIVITYMANAGER_H_
+#define BENCHMARKS_FAKECONNECTIVITYMANAGER_H_
+
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusVirtualObject>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+#include <time.h>
+
+typedef QMap<QString, QVariantMap> InterfaceList;
+typedef QMap<QDBusObjectPath, InterfaceList> ManagedObjectList;
+Q_DECLARE_METATYPE(InterfaceList)
+Q_DECLARE_METATYPE(ManagedObjectList)
+
+static const QString benchDBusInterface = "com.luxoft.ConnectivityManager.Bench";
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const auto skipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const auto skipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+// CLOCK_MONOTONIC is shared between the processes of one machine
+inline qint64 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * One phase of generated churn, rates are events per second.
+ * A script is a list of phases, one per line:
+ *   <duration ms> jitter=<rate> churn=<rate> connect=<rate>
+ */
+struct ChurnPhase
+{
+    int duration = 0;
+    double jitterRate = 0;
+    double churnRate = 0;
+    double connectRate = 0;
+};
+
+/*
+ * Scriptable stand-in for com.luxoft.ConnectivityManager. Exposes the manager
+ * object, N WiFiAccessPoint objects below it and an ObjectManager, and generates
+ * access point churn once Start is called on the Bench interface.
+ *
+ * Every generated change is preceded by a Bench.Tick signal carrying the
+ * monotonic timestamp, a sequence number and the path of the access point that
+ * changes, so the client can measure change-to-signal latency per row.
+ */
+class FakeConnectivityManager : public QDBusVirtualObject
+{
+    Q_OBJECT
+
+public:
+    FakeConnectivityManager(const QDBusConnection &connection, int accessPoints, QObject *parent = nullptr);
+
+    static bool parseScript(const QString &script, QVector<ChurnPhase> *phases);
+
+    void setScript(const QVector<ChurnPhase> &phases) { m_phases = phases; }
+    bool registerService();
+
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override;
+    QString introspect(const QString &path) const override;
+
+private:
+    struct FakeAccessPoint
+    {
+        QString ssid;
+        bool connected = false;
+        int strength = 0;
+        QString security;
+    };
+
+    void start();
+    void startPhase(int index);
+    void reply(const QDBusMessage &message, const QVariantList &arguments = QVariantList());
+
+    void addAccessPoint();
+    void removeAccessPoint(const QString &path);
+    void setConnected(const QString &path, bool connected);
+
+    void jitter();
+    void churn();
+    void toggleConnection();
+    void tick(const QString &path);
+
+    QVariantMap managerProperties() const;
+    QVariantMap accessPointProperties(const QString &path) const;
+    QList<QDBusObjectPath> accessPointPaths() const;
+    QString randomAccessPoint();
+
+    void emitPropertiesChanged(const QString &path, const QString &interface, const QVariantMap &changed);
+    void send(const QDBusMessage &message);
+
+    QDBusConnection m_connection;
+    QMap<QString, FakeAccessPoint> m_accessPoints;
+    QStringList m_order;
+    int m_nextId = 0;
+
+    bool m_wifiEnabled = true;
+    bool m_hotspotEnabled = false;
+    QByteArray m_hotspotSSID = QByteArray("bench-hotspot", 14);
+    QString m_hotspotPassphrase = "benchmark";
+
+    QVector<ChurnPhase> m_phases;
+    int m_phase = -1;
+    QTimer m_phaseTimer;
+    QTimer m_jitterTimer;
+    QTimer m_churnTimer;
+    QTimer m_connectTimer;
+
+    QRandomGenerator m_random;
+
+    quint64 m_methodCalls = 0;
+    quint64 m_signalsSent = 0;
+    quint64 m_ticks = 0;
+};
+
+#endif // BENCHMARKS_FAKECONNECTIVITYMANAGER_H_
@@ -0,0 +1,173 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+#include "benchmarkclient.h"
+#include "fakeconnectivitymanager.h"
+
+/*
+ * End-to-end benchmark of WiFiBackend against a fake connectivity manager.
+ *
+ * For every requested access point count a private dbus-daemon is started and
+ * exported as the system bus, the fake manager is run in a child process
+ * (--fake) and the backend is driven from another child process (--run), so
+ * that each run gets a clean bus connection and clean process statistics.
+ * The client keeps its snapshot in a temporary directory; with --warm a
+ * priming client writes it first, so that the measured run restores it.
+ */
+
+static int runFake(const QCommandLineParser &parser)
+{
+    QVector<ChurnPhase> phases;
+    if (parser.isSet("script")) {
+        QFile file(parser.value("script"));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)
+                || !FakeConnectivityManager::parseScript(QString::fromUtf8(file.readAll()), &phases)) {
+            qWarning() << "Invalid churn script" << parser.value("script");
+            return 1;
+        }
+    } else {
+        ChurnPhase phase;
+        phase.duration = parser.value("duration").toInt();
+        phase.jitterRate = parser.value("jitter").toDouble();
+        phase.churnRate = parser.value("churn").toDouble();
+        phase.connectRate = parser.value("connect").toDouble();
+        phases.append(phase);
+    }
+
+    FakeConnectivityManager *manager = new FakeConnectivityManager(QDBusConnection::systemBus(),
+            parser.value("fake").toInt(), qApp);
+    manager->setScript(phases);
+    if (!manager->registerService())
+        return 1;
+
+    return qApp->exec();
+}
+
+
+static int runClient(const QCommandLineParser &parser)
+{
+    BenchmarkClient client(parser.value("run").toInt(), parser.value("duration").toInt(), parser.value("state"));
+    client.setPriming(parser.isSet("prime"));
+    QObject::connect(&client, &BenchmarkClient::finished, qApp, &QCoreApplication::exit);
+    client.start();
+    return qApp->exec();
+}
+
+
+static bool runClientProcess(const QProcessEnvironment &environment, const QStringList &arguments)
+{
+    QProcess client;
+    client.setProcessEnvironment(environment);
+    client.setProcessChannelMode(QProcess::ForwardedChannels);
+    client.start(QCoreApplication::applicationFilePath(), arguments);
+    return client.waitForFinished(-1) && client.exitCode() == 0;
+}
+
+
+static bool runBenchmark(int accessPoints, const QStringList &forwardedArguments, bool warm)
+{
+    QTemporaryDir stateDirectory;
+    if (!stateDirectory.isValid()) {
+        qWarning() << "Could not create a temporary directory";
+        return false;
+    }
+
+    QProcess daemon;
+    daemon.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    daemon.start(QStringLiteral("dbus-daemon"), QStringList() << "--session" << "--nofork" << "--print-address");
+    if (!daemon.waitForStarted() || !daemon.waitForReadyRead()) {
+        qWarning() << "Could not start dbus-daemon";
+        return false;
+    }
+    const QString address = QString::fromUtf8(daemon.readLine()).trimmed();
+
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(QStringLiteral("DBUS_SYSTEM_BUS_ADDRESS"), address);
+
+    QProcess fake;
+    fake.setProcessEnvironment(environment);
+    fake.setProcessChannelMode(QProcess::ForwardedChannels);
+    fake.start(QCoreApplication::applicationFilePath(),
+            QStringList() << "--fake" << QString::number(accessPoints) << forwardedArguments);
+
+    // Wait for the fake manager to own its name
+    const QString connectionName = QStringLiteral("bench-%1").arg(accessPoints);
+    bool registered = false;
+    {
+        QDBusConnection connection = QDBusConnection::connectToBus(address, connectionName);
+        QElapsedTimer timer;
+        timer.start();
+        while (!registered && timer.elapsed() < 5000) {
+            registered = connection.interface()->isServiceRegistered(connectivityDBusService);
+            if (!registered)
+                QThread::msleep(10);
+        }
+    }
+    QDBusConnection::disconnectFromBus(connectionName);
+
+    bool ok = false;
+    if (registered) {
+        const QStringList clientArguments = QStringList() << "--run" << QString::number(accessPoints)
+                << "--state" << stateDirectory.path() << forwardedArguments;
+        ok = !warm || runClientProcess(environment, QStringList(clientArguments) << "--prime");
+        ok = ok && runClientProcess(environment, clientArguments);
+    } else {
+        qWarning() << "Fake connectivity manager did not show up on" << address;
+    }
+
+    fake.terminate();
+    fake.waitForFinished();
+    daemon.terminate();
+    daemon.waitForFinished();
+    return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end benchmark of the WiFi backend on a private D-Bus");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"aps", "Comma separated access point counts to benchmark.", "counts", "10,100,1000"},
+        {"duration", "Churn duration of a run in ms.", "ms", "5000"},
+        {"jitter", "Strength changes per second.", "rate", "50"},
+        {"churn", "Access points replaced per second.", "rate", "2"},
+        {"connect", "Connect/disconnect toggles per second.", "rate", "0.5"},
+        {"script", "Churn script, one '<ms> jitter=<rate> churn=<rate> connect=<rate>' phase per line.", "file"},
+        {"warm", "Measure a warm start from the snapshot of a priming run instead of a cold start."},
+        {"fake", "Internal: run the fake manager with <count> access points.", "count"},
+        {"run", "Internal: run the backend client expecting <count> access points.", "count"},
+        {"state", "Internal: directory for the snapshot of the backend client.", "dir"},
+        {"prime", "Internal: only leave a snapshot in the state directory."},
+    });
+    parser.process(app);
+
+    if (parser.isSet("fake"))
+        return runFake(parser);
+    if (parser.isSet("run"))
+        return runClient(parser);
+
+    QStringList forwardedArguments;
+    for (const char *option : {"duration", "jitter", "churn", "connect", "script"}) {
+        if (parser.isSet(option))
+            forwardedArguments << QStringLiteral("--%1").arg(option) << parser.value(option);
+    }
+
+    bool ok = true;
+    const QStringList counts = parser.value("aps").split(QLatin1Char(','), skipEmptyParts);
+    for (const QString &count : counts)
+        ok = runBenchmark(count.toInt(), forwardedArguments, parser.isSet("warm")) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+TARGET = tst_wifi_micro_benchmark
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+QT += core ivicore dbus qml testlib
+
+include($$SOURCE_DIR/config.pri)
+include(../../wifibackend.pri)
+
+LIBS += -L$$LIB_DESTDIR -l$$qtLibraryTarget(Connectivity)
+
+INCLUDEPATH += $$OUT_PWD/../../../connectivity
+
+SOURCES += tst_wifi_micro_benchmark.cpp
+
+# make benchmark: per-function numbers of the hot paths, no bus needed
+benchmark.commands = $$OUT_PWD/$$TARGET
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
@@ -0,0 +1,285 @@
+#include <QtTest>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusServer>
+#include <QDBusVirtualObject>
+
+#include "accesspointdecoder.h"
+#include "accesspointsnapshot.h"
+#include "accesspointstore.h"
+#include "accesspointtracker.h"
+#include "backendmetrics.h"
+#include "wifibackend.h"
+
+/*
+ * Micro-benchmarks of the code paths that run on every scan update.
+ *
+ * The D-Bus messages are canned: initTestCase() marshals them once through a
+ * peer-to-peer connection inside the process, so their arguments are the same
+ * demarshalling QDBusArguments the backend gets from the bus. The benchmarks
+ * then decode them over and over without any bus traffic, no dbus-daemon is
+ * needed.
+ */
+
+static const QString cannedInterface = QStringLiteral("com.luxoft.WiFiMicroBenchmark");
+static const QString cannedAccessPointPath = QStringLiteral("/ap/0");
+
+// Keeps every message sent to it over the peer-to-peer connection
+class MessageRecorder : public QDBusVirtualObject
+{
+public:
+    QString introspect(const QString &path) const override
+    {
+        Q_UNUSED(path);
+        return QString();
+    }
+
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override
+    {
+        Q_UNUSED(connection);
+        messages.append(message);
+        return true;
+    }
+
+    QList<QDBusMessage> messages;
+};
+
+
+class WiFiMicroBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void accessPoints_data();
+    void accessPoints();
+    void propertiesChanged_data();
+    void propertiesChanged();
+    void getAllDecoding();
+    void ssidLookup_data();
+    void ssidLookup();
+    void securityType_data();
+    void securityType();
+
+private:
+    static AccessPointStore makeStore(int count);
+
+    QDBusServer *m_server = nullptr;
+    MessageRecorder m_recorder;
+
+    QDBusMessage m_getAll;
+    QDBusMessage m_strengthJitter[2];
+    QDBusMessage m_connectedToggle[2];
+};
+
+
+static QDBusMessage cannedMessage(const QString &path, const QString &member, const QVariantList &arguments)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(QString(), path, cannedInterface, member);
+    message.setArguments(arguments);
+    return message;
+}
+
+
+static QVariantList propertiesChangedArguments(const QString &propertyName, const QVariant &value)
+{
+    QVariantMap changed;
+    changed.insert(propertyName, value);
+    return QVariantList() << accessPointDBusInterface << changed << QStringList();
+}
+
+
+AccessPointStore WiFiMicroBenchmark::makeStore(int count)
+{
+    static const ConnectivityModule::SecurityType securityTypes[] = {
+        ConnectivityModule::SecurityType::NoSecurity,
+        ConnectivityModule::SecurityType::WEP,
+        ConnectivityModule::SecurityType::WPA_PSK,
+        ConnectivityModule::SecurityType::WPA_EAP,
+    };
+
+    AccessPointStore store;
+    QList<QDBusObjectPath> paths;
+    for (int i = 0; i < count; ++i) {
+        const QString path = QStringLiteral("/ap/%1").arg(i);
+        store.insert(path, AccessPoint(QStringLiteral("Network %1").arg(i), i == 0, i % 100, securityTypes[i % 4]));
+        paths.append(QDBusObjectPath(path));
+    }
+    store.setOrder(paths);
+    return store;
+}
+
+
+void WiFiMicroBenchmark::initTestCase()
+{
+    m_server = new QDBusServer(QStringLiteral("unix:tmpdir=/tmp"), this);
+    QVERIFY(m_server->isConnected());
+
+    bool registered = false;
+    const QMetaObject::Connection newConnection = QObject::connect(m_server, &QDBusServer::newConnection, this,
+            [this, &registered](const QDBusConnection &connection) {
+                QDBusConnection peer(connection);
+                registered = peer.registerVirtualObject(QStringLiteral("/"), &m_recorder, QDBusConnection::SubPath);
+            });
+
+    const QString clientName = QStringLiteral("wifi-micro-benchmark");
+    {
+        QDBusConnection client = QDBusConnection::connectToPeer(m_server->address(), clientName);
+        QVERIFY(client.isConnected());
+        QTRY_VERIFY(registered);
+        QObject::disconnect(newConnection);
+
+        QVariantMap properties;
+        properties.insert(QStringLiteral("SSID"), QStringLiteral("Network 0"));
+        properties.insert(QStringLiteral("Connected"), false);
+        properties.insert(QStringLiteral("Strength"), 42);
+        properties.insert(QStringLiteral("Security"), QStringLiteral("wpa-psk"));
+
+        const QList<QDBusMessage> messages = {
+            cannedMessage(cannedAccessPointPath, "GetAll", QVariantList() << properties),
+            // Both inside the same strength bucket
+            cannedMessage(cannedAccessPointPath, "PropertiesChanged", propertiesChangedArguments("Strength", 43)),
+            cannedMessage(cannedAccessPointPath, "PropertiesChanged", propertiesChangedArguments("Strength", 45)),
+            cannedMessage(cannedAccessPointPath, "PropertiesChanged", propertiesChangedArguments("Connected", true)),
+            cannedMessage(cannedAccessPointPath, "PropertiesChanged", propertiesChangedArguments("Connected", false)),
+        };
+        for (const QDBusMessage &message : messages)
+            QVERIFY(client.send(message));
+
+        QTRY_COMPARE(m_recorder.messages.count(), messages.count());
+    }
+    QDBusConnection::disconnectFromPeer(clientName);
+
+    m_getAll = m_recorder.messages.at(0);
+    m_strengthJitter[0] = m_recorder.messages.at(1);
+    m_strengthJitter[1] = m_recorder.messages.at(2);
+    m_connectedToggle[0] = m_recorder.messages.at(3);
+    m_connectedToggle[1] = m_recorder.messages.at(4);
+}
+
+
+void WiFiMicroBenchmark::cleanupTestCase()
+{
+    m_recorder.messages.clear();
+    delete m_server;
+    m_server = nullptr;
+}
+
+
+void WiFiMicroBenchmark::accessPoints_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+
+// The list accessPoints() returns, built once per published snapshot
+void WiFiMicroBenchmark::accessPoints()
+{
+    QFETCH(int, count);
+    const AccessPointStore store = makeStore(count);
+
+    QVariantList accessPoints;
+    QBENCHMARK {
+        accessPoints = store.toVariantList();
+    }
+    QCOMPARE(accessPoints.count(), count);
+}
+
+
+void WiFiMicroBenchmark::propertiesChanged_data()
+{
+    QTest::addColumn<bool>("published");
+    QTest::newRow("strength jitter") << false;
+    QTest::newRow("connected toggle") << true;
+}
+
+
+void WiFiMicroBenchmark::propertiesChanged()
+{
+    QFETCH(bool, published);
+    const QDBusMessage *updates = published ? m_connectedToggle : m_strengthJitter;
+
+    BackendMetrics metrics;
+    AccessPointTracker tracker(&metrics);
+    AccessPointSnapshot snapshot;
+    snapshot.entries.append({ cannedAccessPointPath,
+            AccessPoint(QStringLiteral("Network 0"), false, 42, ConnectivityModule::SecurityType::WPA_PSK) });
+    tracker.restore(snapshot);
+
+    int next = 0;
+    QBENCHMARK {
+        QMetaObject::invokeMethod(&tracker, "propertiesChangedHandler", Qt::DirectConnection,
+                Q_ARG(QDBusMessage, updates[next]));
+        next ^= 1;
+    }
+    QVERIFY(metrics.counter(BackendMetrics::PropertiesChangedDecoded) > 0);
+}
+
+
+void WiFiMicroBenchmark::getAllDecoding()
+{
+    AccessPoint ap("", false, 0, ConnectivityModule::SecurityType::NoSecurity);
+    QBENCHMARK {
+        ap = AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity);
+        const QDBusArgument properties = m_getAll.arguments().value(0).value<QDBusArgument>();
+        AccessPointDecoder::decode(properties, &ap);
+    }
+    QCOMPARE(ap.ssid(), QStringLiteral("Network 0"));
+    QCOMPARE(ap.strength(), 42);
+    QCOMPARE(ap.security(), ConnectivityModule::SecurityType::WPA_PSK);
+}
+
+
+void WiFiMicroBenchmark::ssidLookup_data()
+{
+    accessPoints_data();
+}
+
+
+// What connectToAccessPoint() does before anything goes on the bus
+void WiFiMicroBenchmark::ssidLookup()
+{
+    QFETCH(int, count);
+    const AccessPointStore store = makeStore(count);
+    const QString ssid = QStringLiteral("Network %1").arg(count - 1);
+
+    AccessPointStore::PathId id = AccessPointStore::InvalidId;
+    QBENCHMARK {
+        id = store.findBySsid(ssid);
+    }
+    QCOMPARE(store.objectPath(id), QStringLiteral("/ap/%1").arg(count - 1));
+}
+
+
+void WiFiMicroBenchmark::securityType_data()
+{
+    QTest::addColumn<QString>("securityString");
+    QTest::addColumn<ConnectivityModule::SecurityType>("expected");
+    QTest::newRow("none") << QString() << ConnectivityModule::SecurityType::NoSecurity;
+    QTest::newRow("wep") << QStringLiteral("wep") << ConnectivityModule::SecurityType::WEP;
+    QTest::newRow("wpa-psk") << QStringLiteral("wpa-psk") << ConnectivityModule::SecurityType::WPA_PSK;
+    QTest::newRow("wpa-eap") << QStringLiteral("wpa-eap") << ConnectivityModule::SecurityType::WPA_EAP;
+}
+
+
+// Behind securityTypeString2Enum(), and run for every Security property decoded
+void WiFiMicroBenchmark::securityType()
+{
+    QFETCH(QString, securityString);
+    QFETCH(ConnectivityModule::SecurityType, expected);
+
+    ConnectivityModule::SecurityType security = ConnectivityModule::SecurityType::NoSecurity;
+    QBENCHMARK {
+        security = AccessPointDecoder::securityType(securityString);
+    }
+    QCOMPARE(security, expected);
+}
+
+QTEST_GUILESS_MAIN(WiFiMicroBenchmark)
+
+#include "tst_wifi_micro_benchmark.moc"
@@ -0,0 +1,239 @@
+#include "connectionstatemachine.h"
+
+ConnectionStateMachine::ConnectionStateMachine(BackendMetrics *metrics, QObject *parent) : QObject(parent)
+    , m_metrics(metrics)
+    , m_accessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity)
+    , m_phaseTimer(this)
+{
+    m_phaseTimer.setSingleShot(true);
+    QObject::connect(&m_phaseTimer, &QTimer::timeout, this, &ConnectionStateMachine::phaseTimeout);
+}
+
+
+ConnectivityModule::ConnectionStatus ConnectionStateMachine::connectionStatus() const
+{
+    switch (m_state) {
+    case Associating:
+    case WaitingForCredentials:
+    case ConfiguringAddress:
+        return ConnectivityModule::Connecting;
+    case Connected:
+        return ConnectivityModule::Connected;
+    case Disconnecting:
+        return ConnectivityModule::Disconnecting;
+    case Disconnected:
+        break;
+    }
+    return ConnectivityModule::Disconnected;
+}
+
+
+quint64 ConnectionStateMachine::connectTo(const QString &objectPath, const AccessPoint &ap)
+{
+    if (m_objectPath == objectPath && (isConnecting() || m_state == Connected)) {
+        return 0;
+    }
+
+    if (isConnecting()) {
+        emit superseded(m_objectPath, m_state);
+    }
+
+    // Phases of a superseded attempt are not recorded
+    m_phaseTimer.stop();
+    m_state = Disconnected;
+
+    ++m_attempt;
+    m_attemptClock.start();
+    setAccessPoint(objectPath, ap);
+    setState(Associating);
+    return m_attempt;
+}
+
+
+void ConnectionStateMachine::connectFinished(quint64 attempt, bool succeeded)
+{
+    if (attempt != m_attempt || !isConnecting()) {
+        return;
+    }
+
+    if (!succeeded) {
+        reset();
+        return;
+    }
+
+    // The daemon is done, the address is still to be configured
+    setState(ConfiguringAddress);
+}
+
+
+void ConnectionStateMachine::credentialsRequested()
+{
+    if (isConnecting()) {
+        setState(WaitingForCredentials);
+    }
+}
+
+
+void ConnectionStateMachine::credentialsSent()
+{
+    if (m_state == WaitingForCredentials) {
+        setState(Associating);
+    }
+}
+
+
+bool ConnectionStateMachine::disconnectFrom()
+{
+    if (m_objectPath.isEmpty()) {
+        return false;
+    }
+
+    setState(Disconnecting);
+    return true;
+}
+
+
+void ConnectionStateMachine::disconnectFinished(bool succeeded)
+{
+    // On success the access point tells when it is gone
+    if (m_state == Disconnecting && !succeeded) {
+        reset();
+    }
+}
+
+
+void ConnectionStateMachine::updateAccessPoint(const QString &objectPath, const AccessPoint &ap)
+{
+    if (ap.connected()) {
+        if (objectPath == m_objectPath) {
+            if (isConnecting()) {
+                setAccessPoint(objectPath, ap);
+                setState(Connected);
+            }
+        } else if (m_state == Disconnected || m_state == Connected) {
+            // Connected without an attempt of ours, at startup or by another client
+            m_attemptClock.invalidate();
+            setAccessPoint(objectPath, ap);
+            setState(Connected);
+        }
+        return;
+    }
+
+    if (objectPath == m_objectPath && (m_state == Connected || m_state == Disconnecting)) {
+        reset();
+    }
+}
+
+
+void ConnectionStateMachine::removeAccessPoint(const QString &objectPath)
+{
+    if (objectPath == m_objectPath && m_state != Disconnected) {
+        reset();
+    }
+}
+
+
+void ConnectionStateMachine::setAssociationTimeout(int associationTimeout)
+{
+    if (m_associationTimeout == associationTimeout)
+        return;
+    m_associationTimeout = qMax(0, associationTimeout);
+    emit timeoutsChanged();
+}
+
+
+void ConnectionStateMachine::setCredentialsTimeout(int credentialsTimeout)
+{
+    if (m_credentialsTimeout == credentialsTimeout)
+        return;
+    m_credentialsTimeout = qMax(0, credentialsTimeout);
+    emit timeoutsChanged();
+}
+
+
+void ConnectionStateMachine::setAddressTimeout(int addressTimeout)
+{
+    if (m_addressTimeout == addressTimeout)
+        return;
+    m_addressTimeout = qMax(0, addressTimeout);
+    emit timeoutsChanged();
+}
+
+
+void ConnectionStateMachine::setState(State state)
+{
+    if (m_state == state)
+        return;
+
+    // Only phases that were passed count, not the ones that failed or were aborted
+    if (state != Disconnected && state != Disconnecting && m_phaseClock.isValid()) {
+        const qint64 nsecs = m_phaseClock.nsecsElapsed();
+        if (m_state == Associating) {
+            m_metrics->recordLatency(BackendMetrics::Association, nsecs);
+        } else if (m_state == WaitingForCredentials) {
+            m_metrics->recordLatency(BackendMetrics::Credentials, nsecs);
+        } else if (m_state == ConfiguringAddress) {
+            m_metrics->recordLatency(BackendMetrics::AddressConfiguration, nsecs);
+        }
+    }
+
+    if (state == Connected && m_attemptClock.isValid()) {
+        m_metrics->recordLatency(BackendMetrics::TimeToConnect, m_attemptClock.nsecsElapsed());
+        m_lastTimeToConnect = m_attemptClock.elapsed();
+        m_attemptClock.invalidate();
+    }
+
+    m_state = state;
+    m_phaseClock.start();
+
+    int timeout = 0;
+    switch (m_state) {
+    case Associating:
+    case Disconnecting:
+        timeout = m_associationTimeout;
+        break;
+    case WaitingForCredentials:
+        timeout = m_credentialsTimeout;
+        break;
+    case ConfiguringAddress:
+        timeout = m_addressTimeout;
+        break;
+    case Connected:
+    case Disconnected:
+        break;
+    }
+    if (timeout > 0) {
+        m_phaseTimer.start(timeout);
+    } else {
+        m_phaseTimer.stop();
+    }
+
+    emit stateChanged(m_state);
+}
+
+
+void ConnectionStateMachine::setAccessPoint(const QString &objectPath, const AccessPoint &ap)
+{
+    m_objectPath = objectPath;
+    if (m_accessPoint == ap)
+        return;
+    m_accessPoint = ap;
+    emit accessPointChanged();
+}
+
+
+void ConnectionStateMachine::reset()
+{
+    m_attemptClock.invalidate();
+    setAccessPoint(QString(), AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity));
+    setState(Disconnected);
+}
+
+
+void ConnectionStateMachine::phaseTimeout()
+{
+    const QString objectPath = m_objectPath;
+    const State state = m_state;
+    reset();
+    emit timedOut(objectPath, state);
+}
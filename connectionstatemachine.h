@@ -0,0 +1,108 @@
+#ifndef CONNECTIVITY_CONNECTIONSTATEMACHINE_H_
+#define CONNECTIVITY_CONNECTIONSTATEMACHINE_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "accesspoint.h"
+#include "backendmetrics.h"
+#include "connectivitymodule.h"
+
+/*
+ * The connection to one access point, from the Connect call until the access
+ * point reports itself connected, and back.
+ *
+ * Every phase of a connection attempt is bounded by its own timeout, far below
+ * the D-Bus call timeout; the durations of the phases and the total time to
+ * connect are recorded in the backend metrics. A new attempt supersedes the
+ * running one, replies and events of superseded attempts are ignored.
+ */
+class ConnectionStateMachine : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(State state READ state NOTIFY stateChanged)
+    Q_PROPERTY(int associationTimeout READ associationTimeout WRITE setAssociationTimeout NOTIFY timeoutsChanged)
+    Q_PROPERTY(int credentialsTimeout READ credentialsTimeout WRITE setCredentialsTimeout NOTIFY timeoutsChanged)
+    Q_PROPERTY(int addressTimeout READ addressTimeout WRITE setAddressTimeout NOTIFY timeoutsChanged)
+    Q_PROPERTY(qint64 lastTimeToConnect READ lastTimeToConnect NOTIFY stateChanged)
+
+public:
+    enum State {
+        Disconnected,
+        Associating,            // Connect sent, waiting for the daemon
+        WaitingForCredentials,  // the agent asked the user for a passphrase
+        ConfiguringAddress,     // Connect answered, waiting for the AP to report connected (DHCP)
+        Connected,
+        Disconnecting
+    };
+    Q_ENUM(State)
+
+    explicit ConnectionStateMachine(BackendMetrics *metrics, QObject *parent = nullptr);
+    ~ConnectionStateMachine() = default;
+
+    State state() const { return m_state; }
+    ConnectivityModule::ConnectionStatus connectionStatus() const;
+    bool isConnecting() const { return m_state == Associating || m_state == WaitingForCredentials || m_state == ConfiguringAddress; }
+
+    const QString &objectPath() const { return m_objectPath; }
+    const AccessPoint &accessPoint() const { return m_accessPoint; }
+    quint64 attempt() const { return m_attempt; }
+
+    int associationTimeout() const { return m_associationTimeout; }
+    int credentialsTimeout() const { return m_credentialsTimeout; }
+    int addressTimeout() const { return m_addressTimeout; }
+    qint64 lastTimeToConnect() const { return m_lastTimeToConnect; }
+
+    // Starts a new attempt and returns its id, for connectFinished()
+    quint64 connectTo(const QString &objectPath, const AccessPoint &ap);
+    void connectFinished(quint64 attempt, bool succeeded);
+    void credentialsRequested();
+    void credentialsSent();
+
+    // Returns false when there is nothing to disconnect from
+    bool disconnectFrom();
+    void disconnectFinished(bool succeeded);
+
+    // Live state of an access point, and access points that went away
+    void updateAccessPoint(const QString &objectPath, const AccessPoint &ap);
+    void removeAccessPoint(const QString &objectPath);
+
+public Q_SLOTS:
+    void setAssociationTimeout(int associationTimeout);
+    void setCredentialsTimeout(int credentialsTimeout);
+    void setAddressTimeout(int addressTimeout);
+
+Q_SIGNALS:
+    void stateChanged(State state);
+    void accessPointChanged();
+    void timeoutsChanged();
+    // The attempt on objectPath was left in state, because another one was started
+    void superseded(const QString &objectPath, State state);
+    // The attempt on objectPath did not get past state in time
+    void timedOut(const QString &objectPath, State state);
+
+private:
+    void setState(State state);
+    void setAccessPoint(const QString &objectPath, const AccessPoint &ap);
+    void reset();
+    void phaseTimeout();
+
+    BackendMetrics *m_metrics = nullptr;
+
+    State m_state = Disconnected;
+    QString m_objectPath;
+    AccessPoint m_accessPoint;
+    quint64 m_attempt = 0;
+
+    int m_associationTimeout = 30000;
+    int m_credentialsTimeout = 120000;
+    int m_addressTimeout = 20000;
+
+    QTimer m_phaseTimer;
+    QElapsedTimer m_phaseClock;
+    QElapsedTimer m_attemptClock;
+    qint64 m_lastTimeToConnect = -1;   // ms
+};
+
+#endif // CONNECTIVITY_CONNECTIONSTATEMACHINE_H_
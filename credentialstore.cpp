@@ -0,0 +1,261 @@
+#include "credentialstore.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <QDebug>
+
+#include <openssl/evp.h>
+
+static const quint32 credentialsMagic = 0x50574352; // "PWCR"
+static const quint16 credentialsVersion = 2;
+static const int keySize = 32;
+static const int nonceSize = 12;
+static const int tagSize = 16;
+
+static QByteArray randomBytes(int size)
+{
+    QByteArray bytes(size, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(bytes.data()), size / int(sizeof(quint32)));
+    return bytes;
+}
+
+// The header is authenticated along with the content
+static QByteArray associatedData()
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out << credentialsMagic << credentialsVersion;
+    return header;
+}
+
+
+EncryptedFileCredentialStore::EncryptedFileCredentialStore(const QString &fileName, const QString &keyFileName)
+    : m_fileName(fileName)
+    , m_keyFileName(keyFileName)
+{
+}
+
+
+bool EncryptedFileCredentialStore::lookup(const QString &ssid, QString *passphrase)
+{
+    load();
+    const auto it = m_passphrases.constFind(ssid);
+    if (it == m_passphrases.constEnd())
+        return false;
+    *passphrase = it.value();
+    return true;
+}
+
+
+void EncryptedFileCredentialStore::store(const QString &ssid, const QString &passphrase)
+{
+    load();
+    const auto it = m_passphrases.constFind(ssid);
+    if (it != m_passphrases.constEnd() && it.value() == passphrase)
+        return;
+    m_passphrases.insert(ssid, passphrase);
+    if (!save())
+        qWarning() << Q_FUNC_INFO << "Could not write" << m_fileName;
+}
+
+
+void EncryptedFileCredentialStore::remove(const QString &ssid)
+{
+    load();
+    if (m_passphrases.remove(ssid) && !save())
+        qWarning() << Q_FUNC_INFO << "Could not write" << m_fileName;
+}
+
+
+QStringList EncryptedFileCredentialStore::knownSsids()
+{
+    load();
+    return m_passphrases.keys();
+}
+
+
+QString EncryptedFileCredentialStore::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+            + QStringLiteral("/pelux-wifi/credentials");
+}
+
+
+QString EncryptedFileCredentialStore::defaultKeyFileName()
+{
+    const QString keyFileName = qEnvironmentVariable("PELUX_WIFI_CREDENTIALS_KEY");
+    if (!keyFileName.isEmpty())
+        return keyFileName;
+    return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+            + QStringLiteral("/pelux-wifi/credentials.key");
+}
+
+
+void EncryptedFileCredentialStore::load()
+{
+    if (m_loaded)
+        return;
+    m_loaded = true;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly) || !loadKey())
+        return;
+
+    const QByteArray content = file.readAll();
+    QDataStream in(content);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    QByteArray nonce;
+    QByteArray cipherText;
+    QByteArray tag;
+    in >> magic >> version >> nonce >> cipherText >> tag;
+    if (in.status() != QDataStream::Ok || magic != credentialsMagic || version != credentialsVersion) {
+        qWarning() << Q_FUNC_INFO << "Discarding unreadable" << m_fileName;
+        return;
+    }
+
+    QByteArray plainText;
+    if (!unseal(cipherText, nonce, tag, &plainText)) {
+        qWarning() << Q_FUNC_INFO << "Discarding tampered" << m_fileName;
+        return;
+    }
+
+    QDataStream plain(plainText);
+    plain.setVersion(QDataStream::Qt_5_6);
+    plain >> m_passphrases;
+    if (plain.status() != QDataStream::Ok)
+        m_passphrases.clear();
+    plainText.fill('\0');
+}
+
+
+bool EncryptedFileCredentialStore::save()
+{
+    if (!loadKey())
+        return false;
+
+    QByteArray plainText;
+    {
+        QDataStream out(&plainText, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_6);
+        out << m_passphrases;
+    }
+
+    const QByteArray nonce = randomBytes(nonceSize);
+    QByteArray cipherText;
+    QByteArray tag;
+    const bool sealed = seal(plainText, nonce, &cipherText, &tag);
+    plainText.fill('\0');
+    if (!sealed)
+        return false;
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << credentialsMagic << credentialsVersion << nonce << cipherText << tag;
+    return file.commit();
+}
+
+
+bool EncryptedFileCredentialStore::loadKey()
+{
+    if (!m_key.isEmpty())
+        return true;
+
+    QFile keyFile(m_keyFileName);
+    if (keyFile.open(QIODevice::ReadOnly)) {
+        m_key = keyFile.readAll();
+        if (m_key.size() == keySize)
+            return true;
+        qWarning() << Q_FUNC_INFO << "Ignoring malformed key file" << m_keyFileName;
+        m_key.clear();
+        return false;
+    }
+
+    // First use: the previously stored credentials, if any, cannot be read anymore anyway
+    QDir().mkpath(QFileInfo(m_keyFileName).absolutePath());
+    QSaveFile newKeyFile(m_keyFileName);
+    if (!newKeyFile.open(QIODevice::WriteOnly))
+        return false;
+    newKeyFile.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    const QByteArray key = randomBytes(keySize);
+    newKeyFile.write(key);
+    if (!newKeyFile.commit())
+        return false;
+
+    m_key = key;
+    return true;
+}
+
+
+bool EncryptedFileCredentialStore::seal(const QByteArray &plainText, const QByteArray &nonce,
+        QByteArray *cipherText, QByteArray *tag) const
+{
+    const QByteArray header = associatedData();
+    cipherText->resize(plainText.size());
+    tag->resize(tagSize);
+
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    int length = 0;
+    const bool ok = context
+            && EVP_EncryptInit_ex(context, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1
+            && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, nonce.size(), nullptr) == 1
+            && EVP_EncryptInit_ex(context, nullptr, nullptr,
+                    reinterpret_cast<const unsigned char *>(m_key.constData()),
+                    reinterpret_cast<const unsigned char *>(nonce.constData())) == 1
+            && EVP_EncryptUpdate(context, nullptr, &length,
+                    reinterpret_cast<const unsigned char *>(header.constData()), header.size()) == 1
+            && EVP_EncryptUpdate(context, reinterpret_cast<unsigned char *>(cipherText->data()), &length,
+                    reinterpret_cast<const unsigned char *>(plainText.constData()), plainText.size()) == 1
+            && EVP_EncryptFinal_ex(context, reinterpret_cast<unsigned char *>(cipherText->data()) + length, &length) == 1
+            && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, tagSize, tag->data()) == 1;
+    EVP_CIPHER_CTX_free(context);
+    return ok;
+}
+
+
+bool EncryptedFileCredentialStore::unseal(const QByteArray &cipherText, const QByteArray &nonce,
+        const QByteArray &tag, QByteArray *plainText) const
+{
+    if (nonce.size() != nonceSize || tag.size() != tagSize)
+        return false;
+
+    const QByteArray header = associatedData();
+    QByteArray expectedTag = tag;
+    plainText->resize(cipherText.size());
+
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    int length = 0;
+    const bool ok = context
+            && EVP_DecryptInit_ex(context, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1
+            && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, nonce.size(), nullptr) == 1
+            && EVP_DecryptInit_ex(context, nullptr, nullptr,
+                    reinterpret_cast<const unsigned char *>(m_key.constData()),
+                    reinterpret_cast<const unsigned char *>(nonce.constData())) == 1
+            && EVP_DecryptUpdate(context, nullptr, &length,
+                    reinterpret_cast<const unsigned char *>(header.constData()), header.size()) == 1
+            && EVP_DecryptUpdate(context, reinterpret_cast<unsigned char *>(plainText->data()), &length,
+                    reinterpret_cast<const unsigned char *>(cipherText.constData()), cipherText.size()) == 1
+            && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, tagSize, expectedTag.data()) == 1
+            // Fails unless the tag matches
+            && EVP_DecryptFinal_ex(context, reinterpret_cast<unsigned char *>(plainText->data()) + length, &length) == 1;
+    EVP_CIPHER_CTX_free(context);
+    if (!ok) {
+        plainText->fill('\0');
+        plainText->clear();
+    }
+    return ok;
+}
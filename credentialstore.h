@@ -0,0 +1,63 @@
+#ifndef CONNECTIVITY_CREDENTIALSTORE_H_
+#define CONNECTIVITY_CREDENTIALSTORE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Passphrases of the networks the user connected to before, so the agent can
+ * answer RequestCredentials without asking again. Implementations may keep
+ * them wherever the platform offers, e.g. a keyring service.
+ */
+class CredentialStore
+{
+public:
+    virtual ~CredentialStore() = default;
+
+    virtual bool lookup(const QString &ssid, QString *passphrase) = 0;
+    virtual void store(const QString &ssid, const QString &passphrase) = 0;
+    virtual void remove(const QString &ssid) = 0;
+    virtual QStringList knownSsids() = 0;
+};
+
+/*
+ * Default CredentialStore: one local file, encrypted with AES-256-GCM from
+ * OpenSSL under a fresh nonce on every write.
+ *
+ * The random key lives in a file of its own which only the owner can read,
+ * by default under the config location rather than next to the data. Point
+ * PELUX_WIFI_CREDENTIALS_KEY at protected storage (e.g. a partition backed by
+ * a secure element) so that a copy of the data alone cannot be decrypted, or
+ * provide a keyring backed CredentialStore where the platform has one.
+ */
+class EncryptedFileCredentialStore : public CredentialStore
+{
+public:
+    explicit EncryptedFileCredentialStore(const QString &fileName = defaultFileName(),
+            const QString &keyFileName = defaultKeyFileName());
+
+    bool lookup(const QString &ssid, QString *passphrase) override;
+    void store(const QString &ssid, const QString &passphrase) override;
+    void remove(const QString &ssid) override;
+    QStringList knownSsids() override;
+
+    static QString defaultFileName();
+    static QString defaultKeyFileName();
+
+private:
+    void load();
+    bool save();
+    bool loadKey();
+    bool seal(const QByteArray &plainText, const QByteArray &nonce, QByteArray *cipherText, QByteArray *tag) const;
+    bool unseal(const QByteArray &cipherText, const QByteArray &nonce, const QByteArray &tag, QByteArray *plainText) const;
+
+    QString m_fileName;
+    QString m_keyFileName;
+    QByteArray m_key;
+    QHash<QString, QString> m_passphrases;
+    bool m_loaded = false;
+};
+
+#endif // CONNECTIVITY_CREDENTIALSTORE_H_
@@ -0,0 +1,147 @@
+#include "strengthfilter.h"
+
+#include <algorithm>
+
+void StrengthFilter::setThresholds(const QVector<int> &thresholds)
+{
+    m_thresholds = thresholds;
+    std::sort(m_thresholds.begin(), m_thresholds.end());
+    m_thresholds.erase(std::unique(m_thresholds.begin(), m_thresholds.end()), m_thresholds.end());
+
+    // The published buckets do not mean anything with the new boundaries
+    for (State &state : m_states)
+        state.bucket = -1;
+}
+
+
+void StrengthFilter::setHysteresis(int hysteresis)
+{
+    m_hysteresis = qMax(0, hysteresis);
+}
+
+
+void StrengthFilter::setMinInterval(int minInterval)
+{
+    m_minInterval = qMax(0, minInterval);
+}
+
+
+void StrengthFilter::reset(AccessPointStore::PathId id, int strength, qint64 nowMs)
+{
+    State &current = state(id);
+    if (current.pending)
+        --m_pendingCount;
+    current.bucket = bucket(strength);
+    current.lastPublishedMs = nowMs;
+    current.pending = false;
+}
+
+
+void StrengthFilter::remove(AccessPointStore::PathId id)
+{
+    if (id < 0 || id >= m_states.count())
+        return;
+    if (m_states.at(id).pending)
+        --m_pendingCount;
+    m_states[id] = State();
+}
+
+
+bool StrengthFilter::accept(AccessPointStore::PathId id, int strength, qint64 nowMs)
+{
+    State &current = state(id);
+    const int target = targetBucket(strength, current.bucket);
+
+    if (target == current.bucket) {
+        // Jitter inside the published bucket, or back to it before the deferred update was due
+        if (current.pending) {
+            current.pending = false;
+            --m_pendingCount;
+        }
+        return false;
+    }
+
+    if (current.bucket >= 0 && nowMs - current.lastPublishedMs < m_minInterval) {
+        if (!current.pending)
+            ++m_pendingCount;
+        current.pending = true;
+        current.pendingStrength = strength;
+        return false;
+    }
+
+    if (current.pending) {
+        current.pending = false;
+        --m_pendingCount;
+    }
+    current.bucket = target;
+    current.lastPublishedMs = nowMs;
+    return true;
+}
+
+
+QVector<StrengthFilter::Update> StrengthFilter::takeDue(qint64 nowMs)
+{
+    QVector<Update> due;
+    if (m_pendingCount == 0)
+        return due;
+
+    for (int id = 0; id < m_states.count(); ++id) {
+        State &current = m_states[id];
+        if (!current.pending || nowMs - current.lastPublishedMs < m_minInterval)
+            continue;
+
+        current.pending = false;
+        --m_pendingCount;
+        current.bucket = targetBucket(current.pendingStrength, current.bucket);
+        current.lastPublishedMs = nowMs;
+        due.append(Update(id, current.pendingStrength));
+    }
+    return due;
+}
+
+
+qint64 StrengthFilter::nextDue() const
+{
+    if (m_pendingCount == 0)
+        return -1;
+
+    qint64 next = -1;
+    for (const State &current : m_states) {
+        if (!current.pending)
+            continue;
+        const qint64 due = current.lastPublishedMs + m_minInterval;
+        if (next < 0 || due < next)
+            next = due;
+    }
+    return next;
+}
+
+
+int StrengthFilter::bucket(int strength) const
+{
+    return std::upper_bound(m_thresholds.constBegin(), m_thresholds.constEnd(), strength) - m_thresholds.constBegin();
+}
+
+
+int StrengthFilter::targetBucket(int strength, int currentBucket) const
+{
+    if (currentBucket < 0)
+        return bucket(strength);
+
+    // Upwards the next boundary has to be passed by the hysteresis, downwards undercut by it
+    const int up = bucket(strength - m_hysteresis);
+    if (up > currentBucket)
+        return up;
+    const int down = bucket(strength + m_hysteresis);
+    if (down < currentBucket)
+        return down;
+    return currentBucket;
+}
+
+
+StrengthFilter::State &StrengthFilter::state(AccessPointStore::PathId id)
+{
+    if (id >= m_states.count())
+        m_states.resize(id + 1);
+    return m_states[id];
+}
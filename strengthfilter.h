@@ -0,0 +1,66 @@
+#ifndef CONNECTIVITY_STRENGTHFILTER_H_
+#define CONNECTIVITY_STRENGTHFILTER_H_
+
+#include <QPair>
+#include <QVector>
+
+#include "accesspointstore.h"
+
+/*
+ * Decides which raw Strength updates are worth publishing.
+ *
+ * Strengths are quantized into buckets (the bars shown by the UI). A change
+ * is only accepted once it crosses a bucket boundary by more than the
+ * hysteresis, and at most once per minInterval for every access point; a
+ * crossing arriving earlier is deferred and picked up by takeDue(), unless
+ * the signal returns to the published bucket in the meantime.
+ */
+class StrengthFilter
+{
+public:
+    typedef QPair<AccessPointStore::PathId, int> Update;
+
+    void setThresholds(const QVector<int> &thresholds);
+    void setHysteresis(int hysteresis);
+    void setMinInterval(int minInterval);
+
+    const QVector<int> &thresholds() const { return m_thresholds; }
+    int hysteresis() const { return m_hysteresis; }
+    int minInterval() const { return m_minInterval; }
+
+    // A new or fully re-read access point: its strength is taken as is
+    void reset(AccessPointStore::PathId id, int strength, qint64 nowMs);
+    void remove(AccessPointStore::PathId id);
+    void clear() { m_states.clear(); }
+
+    // Whether the strength of a known access point should be published right away
+    bool accept(AccessPointStore::PathId id, int strength, qint64 nowMs);
+
+    // Deferred updates whose interval has elapsed, accepted as they are returned
+    QVector<Update> takeDue(qint64 nowMs);
+    // Time of the next deferred update, -1 if there is none
+    qint64 nextDue() const;
+
+    int bucket(int strength) const;
+
+private:
+    struct State
+    {
+        int bucket = -1;
+        qint64 lastPublishedMs = 0;
+        int pendingStrength = 0;
+        bool pending = false;
+    };
+
+    int targetBucket(int strength, int currentBucket) const;
+    State &state(AccessPointStore::PathId id);
+
+    QVector<int> m_thresholds = { 20, 40, 60, 80 };
+    int m_hysteresis = 3;
+    int m_minInterval = 1000;
+
+    QVector<State> m_states;
+    int m_pendingCount = 0;
+};
+
+#endif // CONNECTIVITY_STRENGTHFILTER_H_
@@ -0,0 +1,110 @@
+#include "updatescheduler.h"
+
+#include <limits>
+
+UpdateScheduler::UpdateScheduler(QObject *parent) : QObject(parent)
+    , m_timer(this)
+{
+    m_timer.setSingleShot(true);
+    QObject::connect(&m_timer, &QTimer::timeout, this, &UpdateScheduler::fire);
+    setPolicy(Default);
+}
+
+
+void UpdateScheduler::setPolicy(Policy policy)
+{
+    switch (policy) {
+    case Default:
+        m_coalesceInterval = 100;
+        m_maxDelay = 500;
+        m_idleInterval = 500;
+        break;
+    case FrameAligned:
+        m_coalesceInterval = 16;
+        m_maxDelay = 16;
+        m_idleInterval = 16;
+        break;
+    case LowPower:
+        m_coalesceInterval = 2000;
+        m_maxDelay = 5000;
+        m_idleInterval = std::numeric_limits<int>::max();
+        break;
+    case Custom:
+        break;
+    }
+
+    m_policy = policy;
+    m_timer.setTimerType(m_coalesceInterval < 100 ? Qt::PreciseTimer : Qt::CoarseTimer);
+    emit policyChanged();
+}
+
+
+void UpdateScheduler::setCoalesceInterval(int coalesceInterval)
+{
+    if (m_coalesceInterval == coalesceInterval)
+        return;
+    m_coalesceInterval = qMax(0, coalesceInterval);
+    m_policy = Custom;
+    emit policyChanged();
+}
+
+
+void UpdateScheduler::setMaxDelay(int maxDelay)
+{
+    if (m_maxDelay == maxDelay)
+        return;
+    m_maxDelay = qMax(0, maxDelay);
+    m_policy = Custom;
+    emit policyChanged();
+}
+
+
+void UpdateScheduler::setIdleInterval(int idleInterval)
+{
+    if (m_idleInterval == idleInterval)
+        return;
+    m_idleInterval = qMax(0, idleInterval);
+    m_policy = Custom;
+    emit policyChanged();
+}
+
+
+void UpdateScheduler::schedule()
+{
+    if (m_timer.isActive()) {
+        // Already going out on the next event loop iteration
+        if (m_immediate)
+            return;
+
+        const qint64 remaining = qMax<qint64>(0, m_maxDelay - m_pendingSince.elapsed());
+        m_timer.start(int(qMin<qint64>(m_coalesceInterval, remaining)));
+        return;
+    }
+
+    m_pendingSince.start();
+    m_immediate = !m_lastTriggered.isValid() || m_lastTriggered.elapsed() >= m_idleInterval;
+    m_timer.start(m_immediate ? 0 : qMin(m_coalesceInterval, m_maxDelay));
+}
+
+
+void UpdateScheduler::flush()
+{
+    if (m_timer.isActive())
+        fire();
+}
+
+
+void UpdateScheduler::cancel()
+{
+    m_timer.stop();
+    m_immediate = false;
+}
+
+
+void UpdateScheduler::fire()
+{
+    m_timer.stop();
+    m_immediate = false;
+    m_lastTriggered.start();
+    emit triggered();
+}
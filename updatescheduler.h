@@ -0,0 +1,70 @@
+#ifndef CONNECTIVITY_UPDATESCHEDULER_H_
+#define CONNECTIVITY_UPDATESCHEDULER_H_
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+
+/*
+ * Coalesces bursts of change notifications into single updates.
+ *
+ * The first schedule() after an idle period is delivered on the next event loop
+ * iteration. Requests following shortly after are debounced by coalesceInterval,
+ * but never delayed for more than maxDelay after the first one of the burst.
+ */
+class UpdateScheduler : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(Policy policy READ policy WRITE setPolicy NOTIFY policyChanged)
+    Q_PROPERTY(int coalesceInterval READ coalesceInterval WRITE setCoalesceInterval NOTIFY policyChanged)
+    Q_PROPERTY(int maxDelay READ maxDelay WRITE setMaxDelay NOTIFY policyChanged)
+    Q_PROPERTY(int idleInterval READ idleInterval WRITE setIdleInterval NOTIFY policyChanged)
+
+public:
+    enum Policy {
+        Default,        // immediate after idle, bursts coalesced up to 500 ms
+        FrameAligned,   // at most one update per 60 Hz frame
+        LowPower,       // screen off: nothing immediate, updates every few seconds at most
+        Custom
+    };
+    Q_ENUM(Policy)
+
+    explicit UpdateScheduler(QObject *parent = nullptr);
+    ~UpdateScheduler() = default;
+
+    Policy policy() const { return m_policy; }
+    int coalesceInterval() const { return m_coalesceInterval; }
+    int maxDelay() const { return m_maxDelay; }
+    int idleInterval() const { return m_idleInterval; }
+
+    bool isPending() const { return m_timer.isActive(); }
+
+public Q_SLOTS:
+    void setPolicy(Policy policy);
+    void setCoalesceInterval(int coalesceInterval);
+    void setMaxDelay(int maxDelay);
+    void setIdleInterval(int idleInterval);
+
+    void schedule();
+    void flush();
+    void cancel();
+
+Q_SIGNALS:
+    void triggered();
+    void policyChanged();
+
+private:
+    void fire();
+
+    Policy m_policy = Default;
+    int m_coalesceInterval = 100;
+    int m_maxDelay = 500;
+    int m_idleInterval = 500;
+
+    bool m_immediate = false;
+    QTimer m_timer; // child, so that it follows moveToThread()
+    QElapsedTimer m_pendingSince;
+    QElapsedTimer m_lastTriggered;
+};
+
+#endif // CONNECTIVITY_UPDATESCHEDULER_H_
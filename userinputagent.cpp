@@ -5,6 +5,7 @@
 #include <QThread>
 #include <QDBusConnection>
 #include <QDBusArgument>
+#include <QTimerEvent>
 
 
 UserInputAgent::UserInputAgent(QObject *parent) : QDBusAbstractAdaptor(parent)
@@ -12,46 +13,150 @@ UserInputAgent::UserInputAgent(QObject *parent) : QDBusAbstractAdaptor(parent)
 }
 
 
+UserInputAgent::~UserInputAgent()
+{
+    cancel();
+}
+
+
 QMap<QString, QVariant> UserInputAgent::RequestCredentials(const QString &description_type, const QString &description_id, const QMap<QString, QVariant> &requested, const QDBusMessage &message)
 {
     QMap<QString, QVariant> response;
 
-    emit credentialsRequested(description_id);
+    // Anyone on the bus may call us, only the manager gets an answer. Its owner is looked up
+    // when the backend is initialized, nothing blocks here while it is not known yet.
+    if (m_managerOwner.isEmpty() || message.service() != m_managerOwner) {
+        qWarning() << Q_FUNC_INFO << "Rejecting credential request from" << message.service();
+        message.setDelayedReply(true);
+        WiFiBackend::dbusConnection().send(message.createErrorReply(QDBusError::AccessDenied,
+                QStringLiteral("Only the connectivity manager may request credentials")));
+        return response;
+    }
 
-    m_requestData->description_type = description_type;
-    m_requestData->description_id = description_id;
-    m_requestData->request = requested;
+    // A repeated request for the same network replaces the previous one
+    if (const QSharedPointer<RequestData> previous = take(description_id)) {
+        WiFiBackend::dbusConnection().send(previous->errorReply);
+    }
+
+    QSharedPointer<RequestData> requestData = QSharedPointer<RequestData>::create();
+    requestData->description_type = description_type;
+    requestData->description_id = description_id;
+    requestData->request = requested;
 
     const QDBusArgument &arg = (requested.value("password")).value<QDBusArgument>();
     arg.beginStructure();
-    arg >> m_securityKeyword;
+    arg >> requestData->securityKeyword;
     arg.endStructure();
 
     message.setDelayedReply(true);
-    m_requestData->reply = message.createReply();
-    m_requestData->errorReply = message.createErrorReply(QDBusError::Failed, "The user cancelled connection");
+    requestData->reply = message.createReply();
+    requestData->errorReply = message.createErrorReply(QDBusError::Failed, "The user cancelled connection");
+
+    // A second request after a stored answer means the passphrase was rejected. A stored
+    // passphrase only goes to a network we are connecting to, anything else is prompted for.
+    QString passphrase;
+    if (m_credentialStore && m_attempts.contains(description_id) && !m_answeredFromStore.contains(description_id) && !m_promptNext.remove(description_id)
+            && m_credentialStore->lookup(description_id, &passphrase)) {
+        m_answeredFromStore.insert(description_id);
+        answer(requestData, QString(), passphrase);
+        return response;
+    }
+    if (m_credentialStore && m_answeredFromStore.remove(description_id)) {
+        qWarning() << Q_FUNC_INFO << "Stored passphrase for" << description_id << "was rejected";
+        m_credentialStore->remove(description_id);
+    }
+
+    if (m_requestTimeout > 0) {
+        requestData->timerId = startTimer(m_requestTimeout);
+    }
+    m_requests.insert(description_id, requestData);
+
+    emit credentialsRequested(description_id);
 
     return response;
 }
 
     
-void UserInputAgent::sendCredentials(const QString &ssid, const QString &username, const QString &password)
+bool UserInputAgent::sendCredentials(const QString &ssid, const QString &username, const QString &password)
 {
-    m_requestData->request["ssid"] = QVariant(ssid);
-    m_requestData->request["username"] = QVariant(username);
+    const QSharedPointer<RequestData> requestData = take(ssid);
+    if (!requestData) {
+        qWarning() << Q_FUNC_INFO << "No credentials requested for" << ssid;
+        return false;
+    }
+
+    return answer(requestData, username, password);
+}
+
+
+bool UserInputAgent::answer(const QSharedPointer<RequestData> &requestData, const QString &username, const QString &password)
+{
+    requestData->request["ssid"] = QVariant(requestData->description_id);
+    requestData->request["username"] = QVariant(username);
 
     QDBusArgument arg;
     arg.beginStructure();
-    arg << m_securityKeyword << password;
+    arg << requestData->securityKeyword << password;
     arg.endStructure();
-    m_requestData->request["password"] = QVariant::fromValue(arg);
-    m_requestData->reply << m_requestData->request;
-    WiFiBackend::dbusConnection().send(m_requestData->reply);
+    requestData->request["password"] = QVariant::fromValue(arg);
+    requestData->reply << requestData->request;
+    return WiFiBackend::dbusConnection().send(requestData->reply);
+}
+
+
+void UserInputAgent::cancel(const QString &ssid)
+{
+    if (const QSharedPointer<RequestData> requestData = take(ssid)) {
+        WiFiBackend::dbusConnection().send(requestData->errorReply);
+    }
 }
 
 
 void UserInputAgent::cancel()
 {
-    WiFiBackend::dbusConnection().send(m_requestData->errorReply);
+    const QStringList ssids = m_requests.keys();
+    for (const QString &ssid : ssids) {
+        cancel(ssid);
+    }
+}
+
+
+void UserInputAgent::beginAttempt(const QString &ssid)
+{
+    m_attempts.insert(ssid);
+}
+
+
+void UserInputAgent::finishAttempt(const QString &ssid, bool failed)
+{
+    m_attempts.remove(ssid);
+    if (m_answeredFromStore.remove(ssid) && failed) {
+        m_promptNext.insert(ssid);
+    }
 }
 
+
+void UserInputAgent::timerEvent(QTimerEvent *event)
+{
+    for (auto it = m_requests.constBegin(); it != m_requests.constEnd(); ++it) {
+        if (it.value()->timerId != event->timerId()) {
+            continue;
+        }
+
+        const QString ssid = it.key();
+        qWarning() << Q_FUNC_INFO << "Credentials for" << ssid << "were not entered in time";
+        cancel(ssid);
+        emit credentialsRequestExpired(ssid);
+        return;
+    }
+}
+
+
+QSharedPointer<RequestData> UserInputAgent::take(const QString &ssid)
+{
+    const QSharedPointer<RequestData> requestData = m_requests.take(ssid);
+    if (requestData && requestData->timerId != 0) {
+        killTimer(requestData->timerId);
+    }
+    return requestData;
+}
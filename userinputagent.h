@@ -7,8 +7,12 @@
 #include <QDBusMessage>
 #include <QDBusAbstractAdaptor>
 
+#include <QHash>
+#include <QSet>
 #include <QSharedPointer>
 
+#include "credentialstore.h"
+
 #define userInputAgentDBusService "com.luxoft.ConnectivityManager"
 #define userInputAgentDBusInterface "com.luxoft.ConnectivityManager.UserInputAgent"
 #define userInputAgentDBusPath "/"
@@ -18,10 +22,23 @@ struct RequestData
     QString description_type;
     QString description_id;
     QMap<QString, QVariant> request;
+    QString securityKeyword;
     QDBusMessage reply;
     QDBusMessage errorReply;
+    int timerId = 0;
 };
 
+/*
+ * Answers the credential requests of the connectivity manager. Requests are
+ * kept per description_id (the SSID), every one is answered, cancelled or
+ * times out on its own, so parallel connection attempts do not interfere.
+ *
+ * Only the current owner of the connectivity manager's name is answered.
+ * Known networks are answered straight from the credential store, but only
+ * for a connection attempt of ours. Otherwise, when the store has nothing, or
+ * the daemon asks again because the stored passphrase was rejected, the user
+ * is prompted through credentialsRequested().
+ */
 class UserInputAgent : public QDBusAbstractAdaptor
 {
     Q_OBJECT
@@ -29,11 +46,27 @@ class UserInputAgent : public QDBusAbstractAdaptor
 
 public:
     explicit UserInputAgent(QObject *parent = nullptr);
-    ~UserInputAgent() = default;
+    ~UserInputAgent();
 
-    void sendCredentials(const QString &ssid, const QString &username, const QString &password);
+    // Returns false if no request for ssid is pending
+    bool sendCredentials(const QString &ssid, const QString &username, const QString &password);
+    void cancel(const QString &ssid);
     void cancel();
 
+    bool hasPendingRequest(const QString &ssid) const { return m_requests.contains(ssid); }
+
+    // Not owned
+    void setCredentialStore(CredentialStore *credentialStore) { m_credentialStore = credentialStore; }
+    // A connection attempt to ssid was started, a stored passphrase may be sent for it
+    void beginAttempt(const QString &ssid);
+    // Ends the connection attempt to ssid. If it failed after a stored answer, the user is asked next time.
+    void finishAttempt(const QString &ssid, bool failed);
+    // Unique name of the manager, requests from anyone else are rejected
+    void setManagerOwner(const QString &managerOwner) { m_managerOwner = managerOwner; }
+
+    int requestTimeout() const { return m_requestTimeout; }
+    void setRequestTimeout(int requestTimeout) { m_requestTimeout = qMax(0, requestTimeout); }
+
 public Q_SLOTS:
     QVariantMap RequestCredentials(const QString &description_type, 
             const QString &description_id, 
@@ -42,10 +75,23 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void credentialsRequested(const QString &ssid);
+    void credentialsRequestExpired(const QString &ssid);
         
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
 private:
-    QSharedPointer<RequestData> m_requestData = QSharedPointer<RequestData>::create();
-    QString m_securityKeyword;
+    QSharedPointer<RequestData> take(const QString &ssid);
+    bool answer(const QSharedPointer<RequestData> &requestData, const QString &username, const QString &password);
+
+    QHash<QString, QSharedPointer<RequestData> > m_requests;
+    int m_requestTimeout = 120000;
+
+    CredentialStore *m_credentialStore = nullptr;
+    QString m_managerOwner;
+    QSet<QString> m_attempts;           // connections we asked for
+    QSet<QString> m_answeredFromStore;  // during the running attempt
+    QSet<QString> m_promptNext;         // the stored passphrase is not trusted anymore
 };
 
 #endif //CONNECTIVITY_USERINPUTAGENT_H_
@@ -0,0 +1,29 @@
+TARGET = $$qtLibraryTarget(wifi_backend)
+TEMPLATE = lib
+CONFIG += plugin
+
+QT += core ivicore dbus qml
+#QT_FOR_CONFIG += ivicore
+#!qtConfig(ivigenerator): error("No ivigenerator available: Make sure QtIvi is installed and configured correctly")
+
+include($$SOURCE_DIR/config.pri)
+
+LIBS += -L$$LIB_DESTDIR -l$$qtLibraryTarget(Connectivity)
+DESTDIR = $$BUILD_DIR/qtivi
+
+QML_IMPORT_PATH = $$OUT_PWD/qml
+
+PLUGIN_TYPE = qtivi
+
+INCLUDEPATH += $$OUT_PWD/../connectivity
+
+include(wifibackend.pri)
+
+SOURCES += connectivityplugin.cpp
+
+HEADERS += connectivityplugin.h
+
+QMAKE_RPATHDIR += $$QMAKE_REL_RPATH_BASE/$$relative_path($$INSTALL_PREFIX/neptune3/lib, $$INSTALL_PREFIX/neptune3/qtivi)
+
+target.path = $$INSTALL_PREFIX/neptune3/qtivi
+INSTALLS += target
@@ -1,119 +1,313 @@
 #include "wifibackend.h"
 
-#include <QDBusInterface>
 #include <QDBusArgument>
 #include <QDBusPendingReply>
 #include <QDBusPendingCall>
 #include <QDBusVariant>
-#include <QTimer>
+#include <QMetaObject>
+#include <QRegularExpression>
+#include <QVector>
 
 #include <QDebug>
 
+#include "accesspointdecoder.h"
 #include "connectivitymodule.h"
 
+// The daemon expects a NUL terminated byte array
+static QByteArray hotspotSSIDToDBus(const QString &ssid)
+{
+    QByteArray bytes = ssid.toUtf8();
+    if ( !bytes.endsWith('\0') ) {
+        bytes.append('\0');
+    }
+    return bytes;
+}
+
+// Returns what is wrong with a hotspot configuration, an empty string if nothing is
+static QString validateHotspotConfig(const QString &ssid, const QString &passphrase)
+{
+    const int ssidLength = ssid.toUtf8().size();
+    if (ssidLength < 1 || ssidLength > 32) {
+        return QStringLiteral("The hotspot SSID must be 1 to 32 bytes long");
+    }
+
+    // WPA2-PSK: 8 to 63 printable ASCII characters, or the key as 64 hex digits
+    static const QRegularExpression asciiPassphrase(QStringLiteral("^[\\x20-\\x7e]{8,63}$"));
+    static const QRegularExpression hexKey(QStringLiteral("^[0-9A-Fa-f]{64}$"));
+    if (!asciiPassphrase.match(passphrase).hasMatch() && !hexKey.match(passphrase).hasMatch()) {
+        return QStringLiteral("The hotspot passphrase must be 8 to 63 printable ASCII characters or 64 hex digits");
+    }
+    return QString();
+}
+
 WiFiBackend::WiFiBackend(QObject *parent) : WiFiBackendInterface(parent)
+    , m_metrics(new BackendMetrics(this))
+    , m_primaryDevice(new WiFiDevice(connectivityDBusPath, m_metrics, this))
 {
     qRegisterMetaType<QQmlPropertyMap*>();
+    qRegisterMetaType<AccessPointModel*>();
+    qRegisterMetaType<AccessPointViewModel*>();
+    qRegisterMetaType<UpdateScheduler*>();
+    qRegisterMetaType<ConnectionStateMachine*>();
+    qRegisterMetaType<WiFiDevice*>();
+    qRegisterMetaType<QList<QDBusObjectPath> >();
+    qRegisterMetaType<AccessPointSnapshot>();
+    qRegisterMetaType<DeviceAccessPoints>();
 
     ConnectivityModule::registerTypes();
 
-    m_timerToNotify.setInterval(500);
-    m_timerToNotify.setSingleShot(true);
-    QObject::connect(&m_timerToNotify, &QTimer::timeout, this, 
-            [this]() {
-                emit accessPointsChanged( accessPoints() );
+    m_devices.append(m_primaryDevice);
+
+    // The views and the interface properties are about the primary device
+    AccessPointModel *accessPointModel = m_primaryDevice->accessPointModel();
+    m_accessPointsByStrength = new AccessPointViewModel(accessPointModel, AccessPointViewModel::ByStrength, this);
+    m_accessPointsBySecurity = new AccessPointViewModel(accessPointModel, AccessPointViewModel::BySecurity, this);
+    m_accessPointsConnectedFirst = new AccessPointViewModel(accessPointModel, AccessPointViewModel::ConnectedFirst, this);
+    m_bestAccessPoints = new AccessPointViewModel(accessPointModel, AccessPointViewModel::ByStrength, this);
+    m_bestAccessPoints->setLimit(5);
+
+    // Read lazily, once there is a list to mark the known networks in
+    m_credentialStore.reset(new EncryptedFileCredentialStore);
+
+    const StrengthFilter defaultStrengthFilter;
+    for (int threshold : defaultStrengthFilter.thresholds())
+        m_strengthThresholds.append(threshold);
+    m_strengthHysteresis = defaultStrengthFilter.hysteresis();
+    m_strengthUpdateInterval = defaultStrengthFilter.minInterval();
+
+    QObject::connect(m_primaryDevice, &WiFiDevice::accessPointsChanged, this, &WiFiBackend::applyListSnapshot);
+    QObject::connect(m_primaryDevice, &WiFiDevice::accessPointsStaleChanged, this, &WiFiBackend::accessPointsStaleChanged);
+
+    // Further devices are found by the tracker of the manager object
+    AccessPointTracker *tracker = m_primaryDevice->tracker();
+    tracker->setReportDevices(true);
+    QObject::connect(tracker, &AccessPointTracker::devicesFound, this, &WiFiBackend::devicesFound);
+    QObject::connect(tracker, &AccessPointTracker::deviceAdded, this, &WiFiBackend::addDevice);
+    QObject::connect(tracker, &AccessPointTracker::deviceRemoved, this, &WiFiBackend::removeDevice);
+
+    m_snapshotTimer.setInterval(5000);
+    m_snapshotTimer.setSingleShot(true);
+    QObject::connect(&m_snapshotTimer, &QTimer::timeout, this, &WiFiBackend::saveSnapshot);
+
+    // A page closed and opened again right away does not cost a resync
+    m_suspendTimer.setInterval(2000);
+    m_suspendTimer.setSingleShot(true);
+    QObject::connect(&m_suspendTimer, &QTimer::timeout, this, [this]() { setActive(false); });
+
+    wireDevice(m_primaryDevice);
+}
+
+
+WiFiBackend::~WiFiBackend()
+{
+    if (m_snapshotTimer.isActive()) {
+        saveSnapshot();
+    }
+}
+
+
+void WiFiBackend::wireDevice(WiFiDevice *device)
+{
+    ConnectionStateMachine *connectionStateMachine = device->connectionStateMachine();
+    device->setSuspended(!m_active);
+
+    QObject::connect(connectionStateMachine, &ConnectionStateMachine::stateChanged, this,
+            [this, device, connectionStateMachine](ConnectionStateMachine::State state) {
+                if (device == m_primaryDevice) {
+                    setConnectionStatus(connectionStateMachine->connectionStatus());
+                }
+                if (state != ConnectionStateMachine::Disconnected && state != ConnectionStateMachine::Connected) {
+                    return;
+                }
+
+                // The agent serves every device, it stays while any of them is connecting
+                QSet<QString> connectingSsids;
+                for (WiFiDevice *other : qAsConst(m_devices)) {
+                    if (other->connectionStateMachine()->isConnecting()) {
+                        connectingSsids.insert(other->connectionStateMachine()->accessPoint().ssid());
+                    }
+                }
+                if (connectingSsids.isEmpty()) {
+                    WiFiBackend::dbusConnection().unregisterObject(userInputAgentDBusPath);
+                }
+
+                const QString ssid = connectionStateMachine->accessPoint().ssid();
+                if (state == ConnectionStateMachine::Connected && m_credentialStore && m_enteredPassphrases.contains(ssid)) {
+                    m_credentialStore->store(ssid, m_enteredPassphrases.value(ssid));
+                }
+                for (auto it = m_enteredPassphrases.begin(); it != m_enteredPassphrases.end(); ) {
+                    if (connectingSsids.contains(it.key())) {
+                        ++it;
+                    } else {
+                        it = m_enteredPassphrases.erase(it);
+                    }
+                }
+                updateKnownNetworks();
             });
+    // Any device may be the last one to resynchronize after a restart of the manager
+    QObject::connect(device, &WiFiDevice::listSnapshotChanged, this, &WiFiBackend::finishRecovery);
+    QObject::connect(connectionStateMachine, &ConnectionStateMachine::superseded, this,
+            [this, device](const QString &objectPath) { abortConnection(device, objectPath); });
+    QObject::connect(connectionStateMachine, &ConnectionStateMachine::timedOut, this,
+            [this, device](const QString &objectPath, ConnectionStateMachine::State state) {
+                if (state == ConnectionStateMachine::Disconnecting) {
+                    qWarning() << Q_FUNC_INFO << "Disconnecting from" << objectPath << "timed out";
+                    return;
+                }
+                qWarning() << Q_FUNC_INFO << "Connecting to" << objectPath << "timed out in state" << state;
+                setErrorString(QStringLiteral("Connection timed out"));
+                abortConnection(device, objectPath);
+            });
+
+    if (device == m_primaryDevice) {
+        QObject::connect(connectionStateMachine, &ConnectionStateMachine::accessPointChanged, this,
+                [this, connectionStateMachine]() { setActiveAccessPoint(connectionStateMachine->accessPoint()); });
+    }
 }
 
 
 void WiFiBackend::initialize()
 {
+    m_initializationTimer.start();
+
     m_errorString = "";
     emit errorStringChanged(m_errorString);
 
+    startAccessPointTracker();
     connectSignalsHandler();
-        
-    getProperty("WiFiAvailable", 
-            [this](QDBusPendingCallWatcher *watcher) {
-                QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                setAvailable( var.toBool() );
-                watcher->deleteLater();
-            });
 
-    getProperty("WiFiEnabled", 
-            [this](QDBusPendingCallWatcher *watcher) {
-                QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                setEnabled( var.toBool() );
-                watcher->deleteLater();
-            });
+    if (!m_serviceWatcher) {
+        m_serviceWatcher = new QDBusServiceWatcher(connectivityDBusService, WiFiBackend::dbusConnection(),
+                QDBusServiceWatcher::WatchForOwnerChange, this);
+        QObject::connect(m_serviceWatcher, &QDBusServiceWatcher::serviceOwnerChanged,
+                this, &WiFiBackend::serviceOwnerChanged);
+        fetchManagerOwner();
+    }
 
-    getProperty("WiFiHotspotEnabled",
-            [this](QDBusPendingCallWatcher *watcher) {
-                QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                setHotspotEnabled( var.toBool() );
-                watcher->deleteLater();
-            });
+    fetchManagerProperties();
+}
 
-    getProperty("WiFiHotspotSSID",
-            [this](QDBusPendingCallWatcher *watcher) {
-                QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                setHotspotSSID( var.toString() );
-                watcher->deleteLater();
-            });
 
-    getProperty("WiFiHotspotPassphrase",
+void WiFiBackend::fetchManagerOwner()
+{
+    QDBusMessage dbusMessageGetNameOwner =
+        QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"), QStringLiteral("/org/freedesktop/DBus"),
+                QStringLiteral("org.freedesktop.DBus"), "GetNameOwner" );
+    QVariantList args;
+    args.append(QVariant::fromValue( connectivityDBusService ));
+    dbusMessageGetNameOwner.setArguments(args);
+
+    QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(dbusMessageGetNameOwner, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
             [this](QDBusPendingCallWatcher *watcher) {
-                QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                setHotspotPassword( var.toString() );
+                QDBusPendingReply<QString> reply = *watcher;
                 watcher->deleteLater();
+
+                // Not running yet, the watcher reports it once it is
+                if (reply.isError() || m_managerOwnerKnown) {
+                    return;
+                }
+                m_managerOwner = reply.value();
+                if (m_userInputAgent) {
+                    m_userInputAgent->setManagerOwner(m_managerOwner);
+                }
             });
-    
-    getProperty("WiFiAccessPoints",
-            [this](QDBusPendingCallWatcher *watcher) {
+}
+
+
+void WiFiBackend::fetchManagerProperties()
+{
+    // The whole manager interface in one round trip, initializationDone is only
+    // emitted once the state of the first fetch has been applied.
+    QDBusMessage dbusMessageRequestProperties =
+        QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, dbusPropertyInterface, "GetAll" );
+    QVariantList args;
+    args.append(QVariant::fromValue( connectivityDBusInterface ));
+    dbusMessageRequestProperties.setArguments(args);
+
+    QElapsedTimer callTimer;
+    callTimer.start();
+    const quint64 generation = m_managerGeneration;
+    QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(dbusMessageRequestProperties, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, callTimer, generation](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::GetAll, callTimer.nsecsElapsed());
                 QDBusPendingReply<void> reply = *watcher;
-                QDBusMessage message = reply.reply();
-                const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                const QDBusArgument arg = var.value<QDBusArgument>();
-                m_dbusObjList.clear();
-                arg.beginArray();
-                while (!arg.atEnd()) {
-                    QDBusObjectPath path;
-                    arg >> path;
-                    m_dbusObjList.append(path);
+
+                // A previous instance of the manager, the fetch for the current one is on its way
+                if (generation != m_managerGeneration) {
+                    watcher->deleteLater();
+                    return;
                 }
-                arg.endArray();
-                updateAccessPoints();
 
+                if (reply.isError()) {
+                    setErrorString(reply.error().message());
+                    qWarning() << Q_FUNC_INFO << reply.error().name() << ":" << reply.error().message();
+                } else {
+                    QDBusMessage message = reply.reply();
+                    const QDBusArgument arg = message.arguments().first().value<QDBusArgument>();
+                    applyManagerProperties(arg);
+                }
+
+                m_managerPropertiesPending = false;
+                if (m_timeToFirstState >= 0) {
+                    finishRecovery();
+                    watcher->deleteLater();
+                    return;
+                }
+
+                m_timeToFirstState = m_initializationTimer.elapsed();
+                m_metrics->setGauge(BackendMetrics::TimeToFirstState, m_timeToFirstState);
+                qInfo() << Q_FUNC_INFO << "time to first state:" << m_timeToFirstState << "ms";
+
+                emit connectionStatusChanged(m_connectionStatus);
+                emit activeAccessPointChanged(m_activeAccessPoint);
+
+                emit initializationDone();
+                finishRecovery();
                 watcher->deleteLater();
             });
-
-    emit connectionStatusChanged(m_connectionStatus);
-    emit activeAccessPointChanged(m_activeAccessPoint);
-    
-    emit initializationDone();
 }
 
 QVariantList WiFiBackend::accessPoints() const
 {
-    //return m_accessPointObjects.values();
-    QVariantList list;
-    for (auto it = m_dbusObjList.constBegin(); it != m_dbusObjList.constEnd(); ++it) {
-        QString path = (*it).path();
-        if ( m_accessPointObjects.contains(path) ) {
-            list.append( m_accessPointObjects.value(path) );
-        }
+    return m_primaryDevice->accessPoints();
+}
+
+void WiFiBackend::setStrengthThresholds(const QVariantList &strengthThresholds)
+{
+    if (m_strengthThresholds == strengthThresholds)
+        return;
+    m_strengthThresholds = strengthThresholds;
+    applyStrengthFilter();
+}
+
+void WiFiBackend::setStrengthHysteresis(int strengthHysteresis)
+{
+    if (m_strengthHysteresis == strengthHysteresis)
+        return;
+    m_strengthHysteresis = strengthHysteresis;
+    applyStrengthFilter();
+}
+
+void WiFiBackend::setStrengthUpdateInterval(int strengthUpdateInterval)
+{
+    if (m_strengthUpdateInterval == strengthUpdateInterval)
+        return;
+    m_strengthUpdateInterval = strengthUpdateInterval;
+    applyStrengthFilter();
+}
+
+void WiFiBackend::applyStrengthFilter()
+{
+    for (WiFiDevice *device : qAsConst(m_devices)) {
+        device->setStrengthFilter(m_strengthThresholds, m_strengthHysteresis, m_strengthUpdateInterval);
     }
-    return list;
+    emit strengthFilterChanged();
 }
 
 void WiFiBackend::setAvailable(bool available)
@@ -121,6 +315,7 @@ void WiFiBackend::setAvailable(bool available)
     if (m_available == available)
         return;
     m_available = available;
+    m_primaryDevice->setAvailable(available);
     emit availableChanged(m_available);
 }
 
@@ -129,11 +324,10 @@ void WiFiBackend::setEnabled(bool enabled)
     if (m_enabled == enabled)
         return;
 
-    if( setProperty("WiFiEnabled", enabled) ) {
-        m_enabled = enabled;
-        emit enabledChanged(m_enabled);
-    }
-
+    const bool previous = m_enabled;
+    applyEnabled(enabled);
+    setProperty("WiFiEnabled", enabled, previous,
+            [this](const QVariant &value) { applyEnabled( value.toBool() ); });
 }
 
 void WiFiBackend::setHotspotEnabled(bool hotspotEnabled)
@@ -141,10 +335,11 @@ void WiFiBackend::setHotspotEnabled(bool hotspotEnabled)
     if (m_hotspotEnabled == hotspotEnabled)
         return;
 
-    if( setProperty("WiFiHotspotEnabled", hotspotEnabled) ) {
-        m_hotspotEnabled = hotspotEnabled;
-        emit hotspotEnabledChanged(hotspotEnabled);
-    }
+    const bool previous = m_hotspotEnabled;
+    applyHotspotEnabled(hotspotEnabled);
+    ++m_hotspotSequence;
+    setProperty("WiFiHotspotEnabled", hotspotEnabled, previous,
+            [this](const QVariant &value) { applyHotspotEnabled( value.toBool() ); });
 }
 
 void WiFiBackend::setHotspotSSID(const QString &hotspotSSID)
@@ -152,14 +347,11 @@ void WiFiBackend::setHotspotSSID(const QString &hotspotSSID)
     if (m_hotspotSSID == hotspotSSID)
         return;
 
-    QByteArray ssid = hotspotSSID.toUtf8();
-    if ( ssid.at(ssid.length() - 1) != '\0' ) {
-        ssid.append('\0');
-    }
-    if( setProperty("WiFiHotspotSSID", ssid) ) {
-        m_hotspotSSID = hotspotSSID;
-        emit hotspotSSIDChanged(hotspotSSID);
-    }
+    const QByteArray previous = hotspotSSIDToDBus(m_hotspotSSID);
+    applyHotspotSSID(hotspotSSID);
+    ++m_hotspotSequence;
+    setProperty("WiFiHotspotSSID", hotspotSSIDToDBus(hotspotSSID), previous,
+            [this](const QVariant &value) { applyHotspotSSID( QString::fromUtf8(value.toByteArray().constData()) ); });
 }
 
 void WiFiBackend::setHotspotPassword(const QString &hotspotPassword)
@@ -167,10 +359,43 @@ void WiFiBackend::setHotspotPassword(const QString &hotspotPassword)
     if (m_hotspotPassword == hotspotPassword)
         return;
 
-    if( setProperty("WiFiHotspotPassphrase", hotspotPassword) ) {
-        m_hotspotPassword = hotspotPassword;
-        emit hotspotPasswordChanged(hotspotPassword);
-    }
+    const QString previous = m_hotspotPassword;
+    applyHotspotPassword(hotspotPassword);
+    ++m_hotspotSequence;
+    setProperty("WiFiHotspotPassphrase", hotspotPassword, previous,
+            [this](const QVariant &value) { applyHotspotPassword( value.toString() ); });
+}
+
+void WiFiBackend::applyEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    emit enabledChanged(m_enabled);
+}
+
+void WiFiBackend::applyHotspotEnabled(bool hotspotEnabled)
+{
+    if (m_hotspotEnabled == hotspotEnabled)
+        return;
+    m_hotspotEnabled = hotspotEnabled;
+    emit hotspotEnabledChanged(m_hotspotEnabled);
+}
+
+void WiFiBackend::applyHotspotSSID(const QString &hotspotSSID)
+{
+    if (m_hotspotSSID == hotspotSSID)
+        return;
+    m_hotspotSSID = hotspotSSID;
+    emit hotspotSSIDChanged(m_hotspotSSID);
+}
+
+void WiFiBackend::applyHotspotPassword(const QString &hotspotPassword)
+{
+    if (m_hotspotPassword == hotspotPassword)
+        return;
+    m_hotspotPassword = hotspotPassword;
+    emit hotspotPasswordChanged(m_hotspotPassword);
 }
 
 void WiFiBackend::setAccessPoints(const QVariantList &accessPoints)
@@ -181,12 +406,10 @@ void WiFiBackend::setAccessPoints(const QVariantList &accessPoints)
 
 void WiFiBackend::setConnectionStatus(ConnectivityModule::ConnectionStatus connectionStatus)
 {
-    qWarning() << Q_FUNC_INFO << m_connectionStatus << connectionStatus;
     if (m_connectionStatus == connectionStatus)
         return;
     m_connectionStatus = connectionStatus;
     emit connectionStatusChanged(m_connectionStatus);
-    qWarning() << Q_FUNC_INFO << "notified!";
 }
 
 void WiFiBackend::setActiveAccessPoint(const AccessPoint &activeAccessPoint)
@@ -210,10 +433,17 @@ void WiFiBackend::prepareUserInputAgent()
 {
     if (!m_userInputAgent) {
         m_userInputAgent = new UserInputAgent(&m_dbusObject);
+        m_userInputAgent->setCredentialStore(m_credentialStore.data());
+        m_userInputAgent->setManagerOwner(m_managerOwner);
         QObject::connect(m_userInputAgent, &UserInputAgent::credentialsRequested, this, [this](const QString &ssid) {
+                if (WiFiDevice *device = connectingDevice(ssid)) {
+                    device->connectionStateMachine()->credentialsRequested();
+                }
                 Q_EMIT WiFiBackend::credentialsRequested(ssid);
                 });
     }
+    // The prompt lives as long as the phase waiting for it
+    m_userInputAgent->setRequestTimeout(m_primaryDevice->connectionStateMachine()->credentialsTimeout());
     WiFiBackend::dbusConnection().registerObject(userInputAgentDBusPath, userInputAgentDBusInterface, &m_dbusObject);
 }
 
@@ -224,21 +454,33 @@ void WiFiBackend::destroyUserInputAgent()
 
 
 QIviPendingReply<void> WiFiBackend::connectToAccessPoint(const QString &ssid)
+{
+    return connectDevice(m_primaryDevice, ssid);
+}
+
+
+bool WiFiBackend::connectDeviceToAccessPoint(const QString &devicePath, const QString &ssid)
+{
+    WiFiDevice *wifiDevice = device(devicePath);
+    if (!wifiDevice) {
+        qWarning() << Q_FUNC_INFO << "Unknown device" << devicePath;
+        return false;
+    }
+    return connectDevice(wifiDevice, ssid).isSuccessful();
+}
+
+
+QIviPendingReply<void> WiFiBackend::connectDevice(WiFiDevice *device, const QString &ssid)
 {
     QIviPendingReply<void> reply;
     prepareUserInputAgent();
 
     QDBusMessage messageConnect = QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, connectivityDBusInterface, "Connect" );
 
-    QString objectPath;
-    QMap<QString, QVariant>::const_iterator it;
-    for (it = m_accessPointObjects.constBegin(); it != m_accessPointObjects.constEnd(); it++) {
-        AccessPoint ap = it.value().value<AccessPoint>();
-        if (ap.ssid() == ssid) {
-            objectPath = it.key();
-            break;
-        }
-    }
+    const AccessPointStore &accessPointStore = device->accessPointStore();
+    ConnectionStateMachine *connectionStateMachine = device->connectionStateMachine();
+    const AccessPointStore::PathId id = accessPointStore.findBySsid(ssid);
+    const QString objectPath = (id != AccessPointStore::InvalidId) ? accessPointStore.objectPath(id) : QString();
     
     if ( objectPath.isEmpty() ) {
         qWarning() << Q_FUNC_INFO << "Unknown SSID" << ssid << "to connect to.";
@@ -246,31 +488,43 @@ QIviPendingReply<void> WiFiBackend::connectToAccessPoint(const QString &ssid)
         return reply;
     }
 
-    setActiveAccessPoint(AccessPoint(ssid, false, 0, ConnectivityModule::SecurityType::NoSecurity));
-    setConnectionStatus(ConnectivityModule::Connecting);
+    // Connecting to the same access point again keeps the running attempt
+    const quint64 attempt = connectionStateMachine->connectTo(objectPath, accessPointStore.accessPoint(id));
+    if (attempt == 0) {
+        reply.setSuccess();
+        return reply;
+    }
+    m_userInputAgent->beginAttempt(ssid);
 
     QVariantList args;
     args.append(QVariant::fromValue(QDBusObjectPath(objectPath)));
     args.append(QVariant::fromValue(QDBusObjectPath(userInputAgentDBusPath)));
     messageConnect.setArguments(args);
 
+    QElapsedTimer callTimer;
+    callTimer.start();
+    // Gone with the device, if it is removed in the meantime
     QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(messageConnect, ASYNC_CALL_TIMEOUT);
-    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
-    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
-            [this, objectPath](QDBusPendingCallWatcher *watcher) {
-                AccessPoint ap;
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, connectionStateMachine);
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, connectionStateMachine,
+            [this, connectionStateMachine, ssid, attempt, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::Connect, callTimer.nsecsElapsed());
                 QDBusPendingReply<void> reply = *watcher;
+                watcher->deleteLater();
+
+                // A superseded or timed out attempt, its outcome does not matter anymore
+                if (attempt != connectionStateMachine->attempt()) {
+                    return;
+                }
+
                 if (reply.isError()) {
                     QString name = reply.error().name();
                     QString message = reply.error().message();
                     setErrorString(message);
                     qWarning() << Q_FUNC_INFO << name << ":" << message;
-                    setConnectionStatus(ConnectivityModule::Disconnected);
-                    setActiveAccessPoint(AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity));
                 }
-
-                WiFiBackend::dbusConnection().unregisterObject(userInputAgentDBusPath);
-                watcher->deleteLater();
+                m_userInputAgent->finishAttempt(ssid, reply.isError());
+                connectionStateMachine->connectFinished(attempt, !reply.isError());
             });
     
     reply.setSuccess();
@@ -279,52 +533,59 @@ QIviPendingReply<void> WiFiBackend::connectToAccessPoint(const QString &ssid)
 
 
 QIviPendingReply<void> WiFiBackend::disconnectFromAccessPoint(const QString &ssid)
+{
+    return disconnectDevice(m_primaryDevice, ssid);
+}
+
+
+bool WiFiBackend::disconnectDeviceFromAccessPoint(const QString &devicePath, const QString &ssid)
+{
+    WiFiDevice *wifiDevice = device(devicePath);
+    if (!wifiDevice) {
+        qWarning() << Q_FUNC_INFO << "Unknown device" << devicePath;
+        return false;
+    }
+    return disconnectDevice(wifiDevice, ssid).isSuccessful();
+}
+
+
+QIviPendingReply<void> WiFiBackend::disconnectDevice(WiFiDevice *device, const QString &ssid)
 {
     QIviPendingReply<void> reply;
 
-    if (connectionStatus() == ConnectivityModule::Connecting) {
-        m_userInputAgent->cancel();
+    ConnectionStateMachine *connectionStateMachine = device->connectionStateMachine();
+    if (connectionStateMachine->state() == ConnectionStateMachine::WaitingForCredentials && m_userInputAgent) {
+        m_userInputAgent->cancel(connectionStateMachine->accessPoint().ssid());
     }
     
     QDBusMessage messageConnect = QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, connectivityDBusInterface, "Disconnect" );
 
-    QString objectPath;
-    QMap<QString, QVariant>::const_iterator it;
-    for (it = m_accessPointObjects.constBegin(); it != m_accessPointObjects.constEnd(); it++) {
-        AccessPoint ap = it.value().value<AccessPoint>();
-        if (ap.ssid() == ssid) {
-            objectPath = it.key();
-            break;
-        }
-    }
-
-    //if (objectPath.isEmpty()) {
-    if (m_activeObjectPath.isEmpty()) {
+    const QString activeObjectPath = connectionStateMachine->objectPath();
+    if (!connectionStateMachine->disconnectFrom()) {
         qWarning() << Q_FUNC_INFO << "Unknown SSID" << ssid << "to disconnect to.";
         reply.setFailed();
         return reply;
     }
 
     QVariantList args;
-    args.append(QVariant::fromValue(QDBusObjectPath(m_activeObjectPath)));
+    args.append(QVariant::fromValue(QDBusObjectPath(activeObjectPath)));
     messageConnect.setArguments(args);
 
-    setConnectionStatus(ConnectivityModule::Disconnecting);
-
+    QElapsedTimer callTimer;
+    callTimer.start();
     QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(messageConnect, ASYNC_CALL_TIMEOUT);
-    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
-    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
-            [this](QDBusPendingCallWatcher *watcher) {
-                AccessPoint ap;
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, connectionStateMachine);
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, connectionStateMachine,
+            [this, connectionStateMachine, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::Disconnect, callTimer.nsecsElapsed());
                 QDBusPendingReply<void> reply = *watcher;
                 if (reply.isError()) {
                     QString name = reply.error().name();
                     QString message = reply.error().message();
                     setErrorString(message);
                     qWarning() << Q_FUNC_INFO << name << ":" << message;
-                    setConnectionStatus(ConnectivityModule::Disconnected);
-                    //setActiveAccessPoint(AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity));
                 }
+                connectionStateMachine->disconnectFinished(!reply.isError());
                 watcher->deleteLater();
             });
     
@@ -335,171 +596,459 @@ QIviPendingReply<void> WiFiBackend::disconnectFromAccessPoint(const QString &ssi
 
 QIviPendingReply<void> WiFiBackend::sendCredentials(const QString &ssid, const QString &password)
 {
-    m_userInputAgent->sendCredentials(ssid, "", password);
-
     QIviPendingReply<void> reply;
+    if (!m_userInputAgent || !m_userInputAgent->sendCredentials(ssid, "", password)) {
+        reply.setFailed();
+        return reply;
+    }
+
+    if (WiFiDevice *device = connectingDevice(ssid)) {
+        m_enteredPassphrases.insert(ssid, password);
+        device->connectionStateMachine()->credentialsSent();
+    }
+
     reply.setSuccess();
     return reply;
 }
     
 
+QIviPendingReply<void> WiFiBackend::configureHotspot(const QString &ssid, const QString &passphrase, bool enabled)
+{
+    QIviPendingReply<void> reply;
+
+    const QString error = validateHotspotConfig(ssid, passphrase);
+    if (!error.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << error;
+        setErrorString(error);
+        reply.setFailed();
+        return reply;
+    }
+
+    const bool configChanged = ssid != m_hotspotSSID || passphrase != m_hotspotPassword;
+    if (!configChanged && enabled == m_hotspotEnabled) {
+        reply.setSuccess();
+        return reply;
+    }
+
+    // The writes in the order the daemon handles them. A running hotspot is stopped before
+    // its configuration changes and started once afterwards, instead of restarting per write.
+    const bool restart = m_hotspotEnabled && enabled && configChanged;
+    QVector<QPair<QString, QVariant> > writes;
+    if (m_hotspotEnabled && (!enabled || restart)) {
+        writes.append(qMakePair(QStringLiteral("WiFiHotspotEnabled"), QVariant(false)));
+    }
+    if (ssid != m_hotspotSSID) {
+        writes.append(qMakePair(QStringLiteral("WiFiHotspotSSID"), QVariant(hotspotSSIDToDBus(ssid))));
+    }
+    if (passphrase != m_hotspotPassword) {
+        writes.append(qMakePair(QStringLiteral("WiFiHotspotPassphrase"), QVariant(passphrase)));
+    }
+    if (enabled && (!m_hotspotEnabled || restart)) {
+        writes.append(qMakePair(QStringLiteral("WiFiHotspotEnabled"), QVariant(true)));
+    }
+
+    // Single writes still on the bus are superseded: their replies neither send a queued
+    // value nor roll back over the committed configuration anymore
+    m_propertyWrites.remove(QStringLiteral("WiFiHotspotEnabled"));
+    m_propertyWrites.remove(QStringLiteral("WiFiHotspotSSID"));
+    m_propertyWrites.remove(QStringLiteral("WiFiHotspotPassphrase"));
+
+    QSharedPointer<HotspotCommit> commit = QSharedPointer<HotspotCommit>::create();
+    commit->reply = reply;
+    commit->sequence = ++m_hotspotSequence;
+    commit->outstanding = writes.count();
+    commit->previousSSID = m_hotspotSSID;
+    commit->previousPassword = m_hotspotPassword;
+    commit->previousEnabled = m_hotspotEnabled;
+    ++m_hotspotCommitsInFlight;
+
+    applyHotspotSSID(ssid);
+    applyHotspotPassword(passphrase);
+    applyHotspotEnabled(enabled);
+
+    // Not waiting for one write before sending the next, the commit costs a single round trip
+    for (const QPair<QString, QVariant> &write : writes) {
+        QElapsedTimer callTimer;
+        callTimer.start();
+        QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(asyncSet(write.first, write.second), this);
+        const QString propertyName = write.first;
+        QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+                [this, commit, propertyName, callTimer](QDBusPendingCallWatcher *watcher) {
+                    m_metrics->recordLatency(BackendMetrics::Set, callTimer.nsecsElapsed());
+                    QDBusPendingReply<void> reply = *watcher;
+                    watcher->deleteLater();
+
+                    if (reply.isError() && !commit->failed) {
+                        commit->failed = true;
+                        setErrorString(reply.error().message());
+                        qWarning() << Q_FUNC_INFO << propertyName << ":" << reply.error().message();
+                    }
+                    if (--commit->outstanding > 0) {
+                        return;
+                    }
+                    --m_hotspotCommitsInFlight;
+
+                    if (!commit->failed) {
+                        commit->reply.setSuccess();
+                        return;
+                    }
+
+                    // A newer configuration owns the local values, which may be applied already.
+                    // Otherwise some of the writes may have been taken, the daemon tells which.
+                    if (commit->sequence == m_hotspotSequence) {
+                        applyHotspotSSID(commit->previousSSID);
+                        applyHotspotPassword(commit->previousPassword);
+                        applyHotspotEnabled(commit->previousEnabled);
+                    }
+                    commit->reply.setFailed();
+                    fetchManagerProperties();
+                });
+    }
+
+    return reply;
+}
+
+
+QString WiFiBackend::dumpMetrics() const
+{
+    const QString text = m_metrics->dump();
+    qInfo().noquote() << text;
+    return text;
+}
+
+
+void WiFiBackend::setCredentialStore(CredentialStore *credentialStore)
+{
+    if (m_userInputAgent) {
+        m_userInputAgent->setCredentialStore(credentialStore);
+    }
+    m_credentialStore.reset(credentialStore);
+    updateKnownNetworks();
+}
+
+
+void WiFiBackend::forgetNetwork(const QString &ssid)
+{
+    if (m_credentialStore) {
+        m_credentialStore->remove(ssid);
+        updateKnownNetworks();
+    }
+}
+
+
+void WiFiBackend::loadKnownNetworks()
+{
+    if (m_knownNetworksLoaded) {
+        return;
+    }
+    m_knownNetworksLoaded = true;
+    updateKnownNetworks();
+}
+
+
+void WiFiBackend::updateKnownNetworks()
+{
+    if (!m_knownNetworksLoaded) {
+        return;
+    }
+
+    QStringList knownSsids;
+    if (m_credentialStore) {
+        knownSsids = m_credentialStore->knownSsids();
+        knownSsids.sort();
+    }
+    m_accessPointsConnectedFirst->setKnownSsids(knownSsids);
+}
+
+
 QDBusConnection WiFiBackend::dbusConnection()
 {
     return QDBusConnection::systemBus();
 }
 
 
-void WiFiBackend::getProperty( const QString& propertyName, std::function<void(QDBusPendingCallWatcher*)> const& lambda)
+void WiFiBackend::setProperty(const QString &propertyName, const QVariant &propertyValue,
+        const QVariant &confirmedValue, std::function<void(const QVariant&)> const& rollback)
 {
-    QDBusMessage dbusMessageRequestProperties = 
-        QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, dbusPropertyInterface, "Get" );
+    // A write for this property is still on the bus: only remember the latest value,
+    // it is sent once the running Set has been answered.
+    auto it = m_propertyWrites.find(propertyName);
+    if (it != m_propertyWrites.end()) {
+        it->queuedValue = propertyValue;
+        it->queued = true;
+        return;
+    }
+
+    PropertyWrite write;
+    write.confirmedValue = confirmedValue;
+    write.rollback = rollback;
+    m_propertyWrites.insert(propertyName, write);
+
+    sendPropertyWrite(propertyName, propertyValue);
+}
+
+
+QDBusPendingCall WiFiBackend::asyncSet(const QString &propertyName, const QVariant &propertyValue)
+{
+    QDBusMessage dbusMessageSetProperty =
+        QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, dbusPropertyInterface, "Set" );
     QVariantList args;
     args.append(QVariant::fromValue( connectivityDBusInterface ));
     args.append(QVariant::fromValue( propertyName ));
-    dbusMessageRequestProperties.setArguments(args);
+    args.append(QVariant::fromValue( QDBusVariant(propertyValue) ));
+    dbusMessageSetProperty.setArguments(args);
 
-    QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(dbusMessageRequestProperties, ASYNC_CALL_TIMEOUT);
+    return WiFiBackend::dbusConnection().asyncCall(dbusMessageSetProperty, ASYNC_CALL_TIMEOUT);
+}
+
+
+void WiFiBackend::sendPropertyWrite(const QString &propertyName, const QVariant &propertyValue)
+{
+    QElapsedTimer callTimer;
+    callTimer.start();
+    QDBusPendingCall pendingCall = asyncSet(propertyName, propertyValue);
     QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
-      
-    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this, lambda);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, propertyName, propertyValue, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::Set, callTimer.nsecsElapsed());
+                QDBusPendingReply<void> reply = *watcher;
+                watcher->deleteLater();
+
+                auto it = m_propertyWrites.find(propertyName);
+                if (it == m_propertyWrites.end()) {
+                    return;
+                }
+
+                const bool failed = reply.isError();
+                if (failed) {
+                    setErrorString(reply.error().message());
+                    qWarning() << Q_FUNC_INFO << propertyName << ":" << reply.error().message();
+                } else {
+                    it->confirmedValue = propertyValue;
+                }
+
+                if (it->queued && it->queuedValue != it->confirmedValue) {
+                    const QVariant nextValue = it->queuedValue;
+                    it->queued = false;
+                    sendPropertyWrite(propertyName, nextValue);
+                    return;
+                }
+
+                const PropertyWrite write = m_propertyWrites.take(propertyName);
+                if (failed) {
+                    write.rollback(write.confirmedValue);
+                }
+            });
 }
 
-    
-bool WiFiBackend::setProperty(const QString &propertyName, const QVariant &propertyValue)
+
+void WiFiBackend::setAccessPointPaths(const QDBusArgument &arg)
 {
-    QDBusInterface dbusInterface(connectivityDBusService, connectivityDBusPath, connectivityDBusInterface,
-                                    WiFiBackend::dbusConnection(), this
-                                );
+    QList<QDBusObjectPath> paths;
+    arg.beginArray();
+    while (!arg.atEnd()) {
+        QDBusObjectPath path;
+        arg >> path;
+        paths.append(path);
+    }
+    arg.endArray();
 
-    if (!dbusInterface.isValid()) {
-        qWarning() << Q_FUNC_INFO << dbusInterface.lastError().message();
-        return false;
+    m_primaryDevice->setAccessPointPaths(paths);
+}
+
+
+void WiFiBackend::startAccessPointTracker()
+{
+    if (m_trackerStarted) {
+        return;
     }
+    m_trackerStarted = true;
 
-    return dbusInterface.setProperty(propertyName.toLatin1().data(), propertyValue);
+    restoreSnapshot();
+    m_primaryDevice->start(m_workerThreadEnabled);
 }
 
 
-void WiFiBackend::updateAccessPoints()
+void WiFiBackend::applyListSnapshot()
 {
-    if (!m_allowedToUpdateList) {
-        m_requiredUpdate = true;
+    emit accessPointsChanged(m_primaryDevice->accessPoints());
+    m_metrics->increment(BackendMetrics::AccessPointsChangedEmitted);
+    m_metrics->setGauge(BackendMetrics::StoreSize, m_primaryDevice->accessPointStore().count());
+
+    // After the list was painted
+    if (!m_knownNetworksLoaded && m_primaryDevice->accessPointStore().count() > 0) {
+        QTimer::singleShot(0, this, &WiFiBackend::loadKnownNetworks);
+    }
+
+    // Only once the access points themselves or their order changed
+    if (!m_snapshotTimer.isActive() && snapshotPaths() != m_snapshotPaths) {
+        m_snapshotTimer.start();
+    }
+}
+
+
+void WiFiBackend::restoreSnapshot()
+{
+    AccessPointSnapshot snapshot;
+    if (!snapshot.load(m_snapshotFileName)) {
         return;
     }
 
-    m_allowedToUpdateList = false;
+    // Known before the restored list is applied, so that it is not written back right away
+    m_snapshotPaths.clear();
+    for (const AccessPointSnapshot::Entry &entry : qAsConst(snapshot.entries)) {
+        m_snapshotPaths.append(entry.objectPath);
+    }
+    m_primaryDevice->restore(snapshot);
+}
 
-    QTimer::singleShot(700, [this]() {
-            m_allowedToUpdateList = true;
-            if (m_requiredUpdate) {
-                m_requiredUpdate = false;
-                getProperty("WiFiAccessPoints", [this](QDBusPendingCallWatcher *watcher) {
-                    QDBusPendingReply<void> reply = *watcher;
-                    QDBusMessage message = reply.reply();
-                    const QVariant var = message.arguments().first().value<QDBusVariant>().variant();
-                    const QDBusArgument arg = var.value<QDBusArgument>();
-                    m_dbusObjList.clear();
-                    arg.beginArray();
-                    while (!arg.atEnd()) {
-                        QDBusObjectPath path;
-                        arg >> path;
-                        m_dbusObjList.append(path);
-                    }
-                    arg.endArray();
-                    updateAccessPoints();
 
-                    watcher->deleteLater();
-                });
-            }
-            });
+void WiFiBackend::saveSnapshot()
+{
+    if (m_primaryDevice->accessPointsStale()) {
+        return;
+    }
 
-    QMap<QString, bool> newAccessPoints;
-    for (int i=0; i<m_dbusObjList.count(); i++) {
-        QString dbusObjPath = m_dbusObjList.at(i).path();
-        newAccessPoints.insert(dbusObjPath, true);
+    ConnectionStateMachine *connectionStateMachine = m_primaryDevice->connectionStateMachine();
+    AccessPointSnapshot snapshot;
+    snapshot.capture(m_primaryDevice->accessPointStore());
+    if (connectionStateMachine->state() == ConnectionStateMachine::Connected) {
+        snapshot.activeObjectPath = connectionStateMachine->objectPath();
+    }
 
-        if ( m_accessPointObjects.contains(dbusObjPath) ) {
-            continue;
+    if (!snapshot.save(m_snapshotFileName)) {
+        qWarning() << Q_FUNC_INFO << "Could not write" << m_snapshotFileName;
+        return;
+    }
+    m_snapshotPaths = snapshotPaths();
+}
+
+
+QVector<QString> WiFiBackend::snapshotPaths() const
+{
+    const AccessPointStore &store = m_primaryDevice->accessPointStore();
+    QVector<QString> paths;
+    paths.reserve(store.count());
+    for (AccessPointStore::PathId id : store.order()) {
+        if (store.contains(id)) {
+            paths.append(store.objectPath(id));
         }
+    }
+    return paths;
+}
 
-        QDBusMessage dbusMessageRequestProperties = 
-            QDBusMessage::createMethodCall(connectivityDBusService, dbusObjPath, dbusPropertyInterface, "GetAll" );
-        QVariantList args;
-        args.append(QVariant::fromValue( accessPointDBusInterface ));
-        dbusMessageRequestProperties.setArguments(args);
 
-        QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(dbusMessageRequestProperties, ASYNC_CALL_TIMEOUT);
-        QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+QList<QObject*> WiFiBackend::devices() const
+{
+    QList<QObject*> devices;
+    for (WiFiDevice *device : m_devices) {
+        devices.append(device);
+    }
+    return devices;
+}
 
-        QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this, 
-                [this, dbusObjPath](QDBusPendingCallWatcher *watcher) {
-                    QDBusPendingReply<void> reply = *watcher;
 
-                    if (reply.isError()) {
-                        qWarning() << Q_FUNC_INFO << reply.error().message();
-                    } else {
-                        QDBusMessage message = reply.reply();
-                        const QDBusArgument arg = message.arguments().first().value<QDBusArgument>();
-                        AccessPoint ap;
-                        arg.beginMap();
-                        while (!arg.atEnd()) {
-                            arg.beginMapEntry();
-                            QString propertyName;
-                            QVariant propertyValue;
-                            arg >> propertyName >> propertyValue;
-                            if (propertyName == "SSID") {
-                                ap.setSsid( propertyValue.toString() );
-                            } else if (propertyName == "Connected") {
-                                ap.setConnected( propertyValue.toBool() );
-                            } else if (propertyName == "Strength") {
-                                ap.setStrength( propertyValue.toInt() );
-                            } else if (propertyName == "Security") {
-                                ap.setSecurity( securityTypeString2Enum(propertyValue.toString()) );
-                            }
-
-                            arg.endMapEntry();
-                        }
-                        arg.endMap();
-
-                        if (!ap.ssid().isEmpty()) {
-                            if (ap.connected() && (connectionStatus() != ConnectivityModule::Connected)) {
-                                setConnectionStatus(ConnectivityModule::Connected);
-                                setActiveAccessPoint(ap);
-                                m_activeObjectPath = dbusObjPath;
-                            } else if ((connectionStatus() != ConnectivityModule::Disconnected) && (m_activeObjectPath == dbusObjPath) && (!ap.connected())) {
-                                setConnectionStatus(ConnectivityModule::Disconnected);
-                                setActiveAccessPoint(AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity));
-                                m_activeObjectPath = "";
-                            }
-
-                            m_accessPointObjects.insert(dbusObjPath, QVariant::fromValue(ap));
-            
-                            dbusConnection().connect(connectivityDBusService, dbusObjPath, dbusPropertyInterface, 
-                                    QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
-    
-                            m_timerToNotify.start();
-                        }
-                    }
-                    watcher->deleteLater();
-                });
+WiFiDevice *WiFiBackend::device(const QString &objectPath) const
+{
+    for (WiFiDevice *device : m_devices) {
+        if (device->objectPath() == objectPath) {
+            return device;
+        }
+    }
+    return nullptr;
+}
+
+
+WiFiDevice *WiFiBackend::connectingDevice(const QString &ssid) const
+{
+    for (WiFiDevice *device : m_devices) {
+        const ConnectionStateMachine *connectionStateMachine = device->connectionStateMachine();
+        if (connectionStateMachine->isConnecting() && connectionStateMachine->accessPoint().ssid() == ssid) {
+            return device;
+        }
+    }
+    return nullptr;
+}
+
+
+void WiFiBackend::devicesFound(const DeviceAccessPoints &devices)
+{
+    const QList<WiFiDevice*> existingDevices = m_devices;
+    for (WiFiDevice *device : existingDevices) {
+        if (device != m_primaryDevice && !devices.contains(device->objectPath())) {
+            removeDevice(device->objectPath());
+        }
     }
 
-    // Remove unexisting access points
-    bool someAPsRemoved = false;
-    for (auto it = m_accessPointObjects.begin(); it != m_accessPointObjects.end();) {
-        if ( !newAccessPoints.contains(it.key()) ) {
-            dbusConnection().disconnect( connectivityDBusService, it.key(), dbusPropertyInterface,
-                    QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
-            it = m_accessPointObjects.erase(it);
-            someAPsRemoved = true;
-        } else {
-            ++it;
+    bool added = false;
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        if (WiFiDevice *wifiDevice = device(it.key())) {
+            wifiDevice->adopt(it.value());
+            continue;
         }
+
+        // Seeded before start(), so that it does not call GetManagedObjects itself
+        WiFiDevice *wifiDevice = createDevice(it.key());
+        wifiDevice->adopt(it.value());
+        wifiDevice->start(m_workerThreadEnabled);
+        added = true;
+    }
+
+    if (added) {
+        emit devicesChanged();
+    }
+}
+
+
+void WiFiBackend::addDevice(const QString &objectPath)
+{
+    if (device(objectPath)) {
+        return;
+    }
+
+    // Announced after the bulk fetch, its tracker fetches the access points announced so far
+    WiFiDevice *wifiDevice = createDevice(objectPath);
+    wifiDevice->start(m_workerThreadEnabled);
+    emit devicesChanged();
+}
+
+
+WiFiDevice *WiFiBackend::createDevice(const QString &objectPath)
+{
+    WiFiDevice *wifiDevice = new WiFiDevice(objectPath, m_metrics, this);
+    wifiDevice->setExclusive(true);
+    wifiDevice->setBulkFetchShared(true);
+    wifiDevice->routePropertiesChangedFrom(m_primaryDevice);
+    wifiDevice->setStrengthFilter(m_strengthThresholds, m_strengthHysteresis, m_strengthUpdateInterval);
+    wireDevice(wifiDevice);
+    m_devices.append(wifiDevice);
+
+    // The access points announced by the manager are not all the primary device's anymore
+    m_primaryDevice->setExclusive(true);
+    return wifiDevice;
+}
+
+
+void WiFiBackend::removeDevice(const QString &objectPath)
+{
+    WiFiDevice *wifiDevice = device(objectPath);
+    if (!wifiDevice || wifiDevice == m_primaryDevice) {
+        return;
+    }
+
+    // A prompt for an attempt on the device would never be answered
+    ConnectionStateMachine *connectionStateMachine = wifiDevice->connectionStateMachine();
+    if (connectionStateMachine->isConnecting() && m_userInputAgent) {
+        m_userInputAgent->cancel(connectionStateMachine->accessPoint().ssid());
     }
 
-    if (someAPsRemoved) {
-        m_timerToNotify.start();
+    m_devices.removeOne(wifiDevice);
+    if (m_devices.count() == 1) {
+        m_primaryDevice->setExclusive(false);
     }
+    emit devicesChanged();
+    wifiDevice->deleteLater();
 }
 
 
@@ -511,96 +1060,189 @@ void WiFiBackend::connectSignalsHandler()
 
     QDBusConnection conn = WiFiBackend::dbusConnection();
     
+    // The access points are subscribed to by the tracker
     m_dbusSignalsConnected = conn.connect(connectivityDBusService, connectivityDBusPath, dbusPropertyInterface, 
             QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
 }
 
 
+void WiFiBackend::applyManagerProperties(const QDBusArgument &properties)
+{
+    properties.beginMap();
+    while (!properties.atEnd()) {
+        properties.beginMapEntry();
+        QString propertyName;
+        QVariant propertyValue;
+        properties >> propertyName >> propertyValue;
+
+        if (propertyName == "WiFiAvailable") {
+            setAvailable( propertyValue.toBool() );
+        } else if (propertyName == "WiFiAccessPoints") {
+            setAccessPointPaths( propertyValue.value<QDBusArgument>() );
+        } else if (m_propertyWrites.contains(propertyName)
+                || (m_hotspotCommitsInFlight > 0 && propertyName.startsWith(QLatin1String("WiFiHotspot")))) {
+            // Our own write is still in flight, the optimistic value wins
+        } else if (propertyName == "WiFiEnabled") {
+            applyEnabled( propertyValue.toBool() );
+        } else if (propertyName == "WiFiHotspotEnabled") {
+            applyHotspotEnabled( propertyValue.toBool() );
+        } else if (propertyName == "WiFiHotspotSSID") {
+            applyHotspotSSID( propertyValue.toString() );
+        } else if (propertyName == "WiFiHotspotPassphrase") {
+            applyHotspotPassword( propertyValue.toString() );
+        }
+
+        properties.endMapEntry();
+    }
+    properties.endMap();
+}
+
+
 void WiFiBackend::propertiesChangedHandler(const QDBusMessage &message)
 {
+    m_metrics->increment(BackendMetrics::PropertiesChangedReceived);
+
     const QVariantList arguments = message.arguments();
 
     if (arguments.value(0) == connectivityDBusInterface) {
-        const QDBusArgument& argument1 = arguments.value(1).value<QDBusArgument>();
-
-        argument1.beginMap();
-        while (!argument1.atEnd()) {
-            argument1.beginMapEntry();
-            QString propertyName;
-            QVariant propertyValue;
-            argument1 >> propertyName >> propertyValue;
-            if (propertyName == "WiFiEnabled") {
-                setEnabled( propertyValue.toBool() );
-            } else if (propertyName == "WiFiAvailable") {
-                setAvailable( propertyValue.toBool() );
-            } else if (propertyName == "WiFiAccessPoints") {
-                const QDBusArgument &arg = propertyValue.value<QDBusArgument>();
-                m_dbusObjList.clear();
-                arg.beginArray();
-                while (!arg.atEnd()) {
-                    QDBusObjectPath path;
-                    arg >> path;
-                    m_dbusObjList.append(path);
-                }
-                arg.endArray();
-                updateAccessPoints();
-            }
-            argument1.endMapEntry();
+        m_metrics->increment(BackendMetrics::PropertiesChangedDecoded);
+        const QDBusArgument argument1 = arguments.value(1).value<QDBusArgument>();
+        applyManagerProperties(argument1);
+    }
+}
+
+
+void WiFiBackend::serviceOwnerChanged(const QString &service, const QString &oldOwner, const QString &newOwner)
+{
+    if (!oldOwner.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << service << "left the bus";
+
+        // Nobody is waiting for these answers anymore
+        if (m_userInputAgent) {
+            m_userInputAgent->cancel();
         }
-        argument1.endMap();
-    } else if (arguments.value(0) == accessPointDBusInterface) {
-    
-        QString objectPath = message.path();
-        if ( m_accessPointObjects.contains(objectPath) ) {
-            AccessPoint ap = m_accessPointObjects.value(objectPath).value<AccessPoint>();
- 
-            const QDBusArgument argument1 = arguments.value(1).value<QDBusArgument>();
-            argument1.beginMap();
-            while (!argument1.atEnd()) {
-                argument1.beginMapEntry();
-                QString propertyName;
-                QVariant propertyValue;
-                argument1 >> propertyName >> propertyValue;
-                if (propertyName == "SSID") {
-                    ap.setSsid( propertyValue.toString() );
-                } else if (propertyName == "Connected") {
-                    ap.setConnected( propertyValue.toBool() );
-                } else if (propertyName == "Strength") {
-                    ap.setStrength( propertyValue.toInt() );
-                } else if (propertyName == "Security") {
-                    ap.setSecurity( securityTypeString2Enum(propertyValue.toString()) );
-                }
+        setAvailable(false);
+        for (WiFiDevice *device : qAsConst(m_devices)) {
+            device->serviceLost();
+        }
+    }
+
+    // Credential requests are only answered for the current owner
+    m_managerOwner = newOwner;
+    m_managerOwnerKnown = true;
+    if (m_userInputAgent) {
+        m_userInputAgent->setManagerOwner(m_managerOwner);
+    }
+
+    if (newOwner.isEmpty()) {
+        return;
+    }
+
+    ++m_managerGeneration;
+    m_managerPropertiesPending = true;
+    m_recoveryTimer.start();
+    m_metrics->increment(BackendMetrics::ManagerRestarts);
+
+    // The match rule was resolved against the previous owner of the name
+    if (m_dbusSignalsConnected) {
+        WiFiBackend::dbusConnection().disconnect(connectivityDBusService, connectivityDBusPath, dbusPropertyInterface,
+                QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
+        m_dbusSignalsConnected = false;
+    }
+    connectSignalsHandler();
+
+    for (WiFiDevice *device : qAsConst(m_devices)) {
+        device->resync();
+    }
+    fetchManagerProperties();
+}
+
+
+void WiFiBackend::attachConsumer()
+{
+    ++m_consumers;
+    m_suspendTimer.stop();
+    setActive(true);
+}
+
+
+void WiFiBackend::detachConsumer()
+{
+    if (m_consumers == 0) {
+        qWarning() << Q_FUNC_INFO << "No consumer attached";
+        return;
+    }
+    if (--m_consumers == 0 && !m_alwaysActive) {
+        m_suspendTimer.start();
+    }
+}
 
-                argument1.endMapEntry();
-            }
-            argument1.endMap();
-                
-            m_accessPointObjects.insert(objectPath, QVariant::fromValue(ap));
-            if ((connectionStatus() != ConnectivityModule::Connected) && ap.connected() ) {
-                setConnectionStatus(ConnectivityModule::Connected);
-                setActiveAccessPoint(ap);
-                m_activeObjectPath = objectPath;
-            } else if ((connectionStatus() != ConnectivityModule::Disconnected) && (m_activeObjectPath == objectPath) && (!ap.connected())) {
-                setConnectionStatus(ConnectivityModule::Disconnected);
-                setActiveAccessPoint(AccessPoint("", false, 0, ConnectivityModule::SecurityType::NoSecurity));
-                m_activeObjectPath = "";
-            }
-            m_timerToNotify.start();
+
+void WiFiBackend::setActive(bool active)
+{
+    if (m_active == active)
+        return;
+    m_active = active;
+
+    // Resuming devices catch up with one bulk fetch, split across them by the primary one
+    for (WiFiDevice *device : qAsConst(m_devices)) {
+        device->setSuspended(!m_active);
+    }
+    emit activeChanged(m_active);
+}
+
+
+void WiFiBackend::finishRecovery()
+{
+    // Both the manager properties and the access point lists of the new instance have to be in
+    if (!m_recoveryTimer.isValid() || m_managerPropertiesPending) {
+        return;
+    }
+    for (WiFiDevice *device : qAsConst(m_devices)) {
+        const AccessPointListSnapshotPtr &snapshot = device->listSnapshot();
+        if (!snapshot || snapshot->generation != m_managerGeneration || snapshot->stale) {
+            return;
         }
     }
+
+    const qint64 nsecs = m_recoveryTimer.nsecsElapsed();
+    m_recoveryTimer.invalidate();
+    m_metrics->recordLatency(BackendMetrics::Recovery, nsecs);
+    qInfo() << Q_FUNC_INFO << "resynchronized with" << connectivityDBusService << "in" << nsecs / 1000000 << "ms";
 }
 
 
-ConnectivityModule::SecurityType WiFiBackend::securityTypeString2Enum(const QString& securityString)
+void WiFiBackend::abortConnection(WiFiDevice *device, const QString &dbusObjPath)
 {
-    ConnectivityModule::SecurityType security = ConnectivityModule::SecurityType::NoSecurity;
-    if (securityString == "wep") {
-        security = ConnectivityModule::SecurityType::WEP;
-    } else if (securityString == "wpa-psk") {
-        security = ConnectivityModule::SecurityType::WPA_PSK;
-    } else if (securityString == "wpa-eap") {
-        security = ConnectivityModule::SecurityType::WPA_EAP;
+    // Only the prompt of this network, others may be waiting for the user as well
+    const AccessPointStore &accessPointStore = device->accessPointStore();
+    const AccessPointStore::PathId id = accessPointStore.pathId(dbusObjPath);
+    if (m_userInputAgent && accessPointStore.contains(id)) {
+        const QString ssid = accessPointStore.accessPoint(id).ssid();
+        m_userInputAgent->cancel(ssid);
+        m_userInputAgent->finishAttempt(ssid, false);
     }
-    return security;
+
+    // The daemon may still be working on it, tell it to stop
+    QDBusMessage messageDisconnect =
+        QDBusMessage::createMethodCall(connectivityDBusService, connectivityDBusPath, connectivityDBusInterface, "Disconnect" );
+    QVariantList args;
+    args.append(QVariant::fromValue(QDBusObjectPath(dbusObjPath)));
+    messageDisconnect.setArguments(args);
+
+    QElapsedTimer callTimer;
+    callTimer.start();
+    QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(messageDisconnect, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::Disconnect, callTimer.nsecsElapsed());
+                watcher->deleteLater();
+            });
 }
 
+
+ConnectivityModule::SecurityType WiFiBackend::securityTypeString2Enum(const QString& securityString)
+{
+    return AccessPointDecoder::securityType(securityString);
+}
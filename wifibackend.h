@@ -6,33 +6,66 @@
 #include <QVariant>
 #include <QQmlPropertyMap>
 
+#include <QDBusArgument>
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDBusObjectPath>
+#include <QHash>
 #include <QMap>
 #include <QDBusPendingCallWatcher>
+#include <QDBusServiceWatcher>
+#include <QElapsedTimer>
 #include <QPair>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThread>
 #include <QTimer>
 
 #include "accesspoint.h"
+#include "accesspointmodel.h"
+#include "accesspointsnapshot.h"
+#include "accesspointstore.h"
+#include "accesspointtracker.h"
+#include "accesspointviewmodel.h"
+#include "backendmetrics.h"
+#include "connectionstatemachine.h"
+#include "credentialstore.h"
 #include "wifibackendinterface.h"
 #include "userinputagent.h"
+#include "updatescheduler.h"
+#include "wifidevice.h"
 
 static const QString connectivityDBusService = "com.luxoft.ConnectivityManager";
 static const QString connectivityDBusInterface = "com.luxoft.ConnectivityManager";
 static const QString connectivityDBusPath = "/com/luxoft/ConnectivityManager";
 static const QString dbusPropertyInterface = "org.freedesktop.DBus.Properties";
 static const QString accessPointDBusInterface = "com.luxoft.ConnectivityManager.WiFiAccessPoint";
+static const QString dbusObjectManagerInterface = "org.freedesktop.DBus.ObjectManager";
+static const QString wifiDeviceDBusInterface = "com.luxoft.ConnectivityManager.WiFiDevice";
 
 #define ASYNC_CALL_TIMEOUT 180000 
 
 class WiFiBackend : public WiFiBackendInterface
 {
     Q_OBJECT
+    Q_PROPERTY(AccessPointModel *accessPointModel READ accessPointModel CONSTANT)
+    Q_PROPERTY(AccessPointViewModel *accessPointsByStrength READ accessPointsByStrength CONSTANT)
+    Q_PROPERTY(AccessPointViewModel *accessPointsBySecurity READ accessPointsBySecurity CONSTANT)
+    Q_PROPERTY(AccessPointViewModel *accessPointsConnectedFirst READ accessPointsConnectedFirst CONSTANT)
+    Q_PROPERTY(AccessPointViewModel *bestAccessPoints READ bestAccessPoints CONSTANT)
+    Q_PROPERTY(UpdateScheduler *updateScheduler READ updateScheduler CONSTANT)
+    Q_PROPERTY(ConnectionStateMachine *connectionStateMachine READ connectionStateMachine CONSTANT)
+    Q_PROPERTY(QQmlPropertyMap *metrics READ metrics CONSTANT)
+    Q_PROPERTY(QList<QObject*> devices READ devices NOTIFY devicesChanged)
+    Q_PROPERTY(bool active READ active NOTIFY activeChanged)
+    Q_PROPERTY(bool accessPointsStale READ accessPointsStale NOTIFY accessPointsStaleChanged)
+    Q_PROPERTY(QVariantList strengthThresholds READ strengthThresholds WRITE setStrengthThresholds NOTIFY strengthFilterChanged)
+    Q_PROPERTY(int strengthHysteresis READ strengthHysteresis WRITE setStrengthHysteresis NOTIFY strengthFilterChanged)
+    Q_PROPERTY(int strengthUpdateInterval READ strengthUpdateInterval WRITE setStrengthUpdateInterval NOTIFY strengthFilterChanged)
 
 public:
     explicit WiFiBackend(QObject *parent = nullptr);
-    ~WiFiBackend() = default;
+    ~WiFiBackend();
 
     Q_INVOKABLE void initialize() override;
 
@@ -44,8 +77,55 @@ public:
     ConnectivityModule::ConnectionStatus connectionStatus() const { return m_connectionStatus; }
     AccessPoint activeAccessPoint() const { return m_activeAccessPoint; };
     QString errorString() const { return m_errorString; }
+    qint64 timeToFirstState() const { return m_timeToFirstState; }
+    bool accessPointsStale() const { return m_primaryDevice->accessPointsStale(); }
+    bool active() const { return m_active; }
+
+    QString snapshotFileName() const { return m_snapshotFileName; }
+    void setSnapshotFileName(const QString &snapshotFileName) { m_snapshotFileName = snapshotFileName; }
+
+    // Decode the access points in a thread of their own, only honoured before initialize()
+    bool workerThreadEnabled() const { return m_workerThreadEnabled; }
+    void setWorkerThreadEnabled(bool enabled) { m_workerThreadEnabled = enabled; }
+
+    // Strength updates are only published when they move to another bucket by more than
+    // the hysteresis, and at most every strengthUpdateInterval ms per access point.
+    QVariantList strengthThresholds() const { return m_strengthThresholds; }
+    int strengthHysteresis() const { return m_strengthHysteresis; }
+    int strengthUpdateInterval() const { return m_strengthUpdateInterval; }
+    void setStrengthThresholds(const QVariantList &strengthThresholds);
+    void setStrengthHysteresis(int strengthHysteresis);
+    void setStrengthUpdateInterval(int strengthUpdateInterval);
 
     QVariantList accessPoints() const;
+    AccessPointModel *accessPointModel() const { return m_primaryDevice->accessPointModel(); }
+    AccessPointViewModel *accessPointsByStrength() const { return m_accessPointsByStrength; }
+    AccessPointViewModel *accessPointsBySecurity() const { return m_accessPointsBySecurity; }
+    AccessPointViewModel *accessPointsConnectedFirst() const { return m_accessPointsConnectedFirst; }
+    AccessPointViewModel *bestAccessPoints() const { return m_bestAccessPoints; }
+    UpdateScheduler *updateScheduler() const { return m_primaryDevice->updateScheduler(); }
+    ConnectionStateMachine *connectionStateMachine() const { return m_primaryDevice->connectionStateMachine(); }
+    QQmlPropertyMap *metrics() const { return m_metrics->propertyMap(); }
+    Q_INVOKABLE QString dumpMetrics() const;
+
+    // Every WiFi device, the primary one, which the interface above is about, first
+    QList<QObject*> devices() const;
+    Q_INVOKABLE bool connectDeviceToAccessPoint(const QString &devicePath, const QString &ssid);
+    Q_INVOKABLE bool disconnectDeviceFromAccessPoint(const QString &devicePath, const QString &ssid);
+
+    // The objectPath role of the rows a view shows, from accessPointModel or any of the sorted
+    // views of it; their details are fetched first
+    Q_INVOKABLE void setVisiblePaths(const QStringList &paths) { m_primaryDevice->setVisiblePaths(paths); }
+
+    // Takes ownership, nullptr always asks the user
+    void setCredentialStore(CredentialStore *credentialStore);
+    Q_INVOKABLE void forgetNetwork(const QString &ssid);
+
+    // Views of the access point lists attach while they are shown. Once the last one has
+    // detached the backend is passive and only follows the connection. Clients which
+    // never attach keep it active.
+    Q_INVOKABLE void attachConsumer();
+    Q_INVOKABLE void detachConsumer();
     void setAccessPoints(const QVariantList &accessPoints);
     void setConnectionStatus(ConnectivityModule::ConnectionStatus connectionStatus);
     void setActiveAccessPoint(const AccessPoint &activeAccessPoint);
@@ -64,14 +144,55 @@ public Q_SLOTS:
     virtual QIviPendingReply<void> disconnectFromAccessPoint(const QString &ssid) override;
     virtual QIviPendingReply<void> sendCredentials(const QString &ssid, const QString &password) override;
 
+    // SSID, passphrase and enabled state validated and committed together: one round trip,
+    // the changed signals emitted at once, and a running hotspot restarted at most once
+    Q_INVOKABLE QIviPendingReply<void> configureHotspot(const QString &ssid, const QString &passphrase, bool enabled);
+
+Q_SIGNALS:
+    void accessPointsStaleChanged(bool accessPointsStale);
+    void activeChanged(bool active);
+    void strengthFilterChanged();
+    void devicesChanged();
+
 private Q_SLOTS:
     void propertiesChangedHandler(const QDBusMessage &message);
+    void serviceOwnerChanged(const QString &service, const QString &oldOwner, const QString &newOwner);
+    void devicesFound(const DeviceAccessPoints &devices);
+    void addDevice(const QString &objectPath);
+    void removeDevice(const QString &objectPath);
 
 private:
-    void getProperty(const QString &propertyName, std::function<void(QDBusPendingCallWatcher*)> const& lambda);
-    bool setProperty(const QString &propertyName, const QVariant &propertyValue);
+    void setProperty(const QString &propertyName, const QVariant &propertyValue,
+            const QVariant &confirmedValue, std::function<void(const QVariant&)> const& rollback);
+    void sendPropertyWrite(const QString &propertyName, const QVariant &propertyValue);
+    QDBusPendingCall asyncSet(const QString &propertyName, const QVariant &propertyValue);
+
+    void applyEnabled(bool enabled);
+    void applyHotspotEnabled(bool hotspotEnabled);
+    void applyHotspotSSID(const QString &hotspotSSID);
+    void applyHotspotPassword(const QString &hotspotPassword);
 
-    void updateAccessPoints();
+    void startAccessPointTracker();
+    void fetchManagerProperties();
+    void fetchManagerOwner();
+    void finishRecovery();
+    void setActive(bool active);
+    void setAccessPointPaths(const QDBusArgument &arg);
+    void applyManagerProperties(const QDBusArgument &properties);
+    void applyListSnapshot();
+    void applyStrengthFilter();
+    void restoreSnapshot();
+    void saveSnapshot();
+    QVector<QString> snapshotPaths() const;
+    void wireDevice(WiFiDevice *device);
+    WiFiDevice *createDevice(const QString &objectPath);
+    WiFiDevice *device(const QString &objectPath) const;
+    WiFiDevice *connectingDevice(const QString &ssid) const;
+    QIviPendingReply<void> connectDevice(WiFiDevice *device, const QString &ssid);
+    QIviPendingReply<void> disconnectDevice(WiFiDevice *device, const QString &ssid);
+    void abortConnection(WiFiDevice *device, const QString &dbusObjPath);
+    void loadKnownNetworks();
+    void updateKnownNetworks();
     void connectSignalsHandler();
     ConnectivityModule::SecurityType securityTypeString2Enum(const QString& securityString);
 
@@ -84,26 +205,94 @@ private:
 
     ConnectivityModule::ConnectionStatus m_connectionStatus = ConnectivityModule::Disconnected;
     AccessPoint m_activeAccessPoint;
-    QString m_activeObjectPath;
 
     QString m_errorString;
 
-    QMap<QString, QVariant> m_accessPointObjects; //dbus object path -> QVariant(AccessPoint)
-    QList<QDBusObjectPath> m_dbusObjList;
-    QVariantList m_accessPoints;
+    // Asynchronous Set calls per property. The local value is updated optimistically,
+    // writes issued while one is in flight are coalesced into queuedValue and a failed
+    // write restores the last value the daemon accepted.
+    struct PropertyWrite
+    {
+        QVariant confirmedValue;
+        QVariant queuedValue;
+        bool queued = false;
+        std::function<void(const QVariant&)> rollback;
+    };
+    QHash<QString, PropertyWrite> m_propertyWrites;
+
+    // A configureHotspot() on the bus: the reply is only answered once all of its writes were.
+    // While any is in flight the hotspot properties the daemon reports are not applied.
+    // A failed commit only restores the previous values if no hotspot write was issued after it.
+    struct HotspotCommit
+    {
+        QIviPendingReply<void> reply;
+        quint64 sequence = 0;
+        int outstanding = 0;
+        bool failed = false;
+        QString previousSSID;
+        QString previousPassword;
+        bool previousEnabled = false;
+    };
+    int m_hotspotCommitsInFlight = 0;
+    // Bumped by every commit and every single hotspot property write
+    quint64 m_hotspotSequence = 0;
+
+    BackendMetrics *m_metrics = nullptr;
+
+    // The manager object itself, and the further devices it exports
+    WiFiDevice *m_primaryDevice = nullptr;
+    QList<WiFiDevice*> m_devices;
+    bool m_trackerStarted = false;
+    bool m_workerThreadEnabled = qEnvironmentVariableIntValue("PELUX_WIFI_WORKER_THREAD") != 0;
+
+    // Consumers attached to the lists, passive mode follows the last one after a grace period
+    int m_consumers = 0;
+    bool m_alwaysActive = qEnvironmentVariableIntValue("PELUX_WIFI_ALWAYS_ACTIVE") != 0;
+    bool m_active = true;
+    QTimer m_suspendTimer;
+
+    QVariantList m_strengthThresholds;
+    int m_strengthHysteresis = 0;
+    int m_strengthUpdateInterval = 0;
+
+    // Sorted views kept up to date from the model's row changes
+    AccessPointViewModel *m_accessPointsByStrength = nullptr;
+    AccessPointViewModel *m_accessPointsBySecurity = nullptr;
+    AccessPointViewModel *m_accessPointsConnectedFirst = nullptr;
+    AccessPointViewModel *m_bestAccessPoints = nullptr;
 
     bool m_dbusSignalsConnected = false;
 
+    // Restarts of the manager: the state is resynchronized, not rebuilt, for every new owner of its name
+    QDBusServiceWatcher *m_serviceWatcher = nullptr;
+    quint64 m_managerGeneration = 0;
+    bool m_managerPropertiesPending = false;
+    // Unique name of the manager, the only one whose credential requests are answered.
+    // Once the watcher has reported an owner, the reply of the initial lookup is outdated.
+    QString m_managerOwner;
+    bool m_managerOwnerKnown = false;
+    QElapsedTimer m_recoveryTimer;
+
+    QElapsedTimer m_initializationTimer;
+    qint64 m_timeToFirstState = -1; // ms from initialize() until the manager state was applied
+
     QObject m_dbusObject;
     UserInputAgent *m_userInputAgent = nullptr;
 
+    // Passphrases of known networks. One typed by the user is only kept once it connected.
+    QScopedPointer<CredentialStore> m_credentialStore;
+    bool m_knownNetworksLoaded = false;
+    QHash<QString, QString> m_enteredPassphrases;
+
     void prepareUserInputAgent();
     void destroyUserInputAgent();
 
-    bool m_allowedToUpdateList = true;
-    bool m_requiredUpdate = false;
-
-    QTimer m_timerToNotify;
+    // Warm start: the list of the primary device is restored from the snapshot until live
+    // D-Bus state confirmed it
+    QString m_snapshotFileName = AccessPointSnapshot::defaultFileName();
+    QTimer m_snapshotTimer;
+    // The listed paths as last restored or written; strength changes alone do not cost a write
+    QVector<QString> m_snapshotPaths;
 };
 
 #endif // CONNECTIVITY_WIFIBACKEND_H_
@@ -0,0 +1,37 @@
+# Backend sources shared by the plugin and the benchmarks
+
+INCLUDEPATH += $$PWD
+
+# AES-256-GCM of the credential store
+CONFIG += link_pkgconfig
+PKGCONFIG += libcrypto
+
+SOURCES += $$PWD/wifibackend.cpp \
+           $$PWD/accesspointdecoder.cpp \
+           $$PWD/accesspointmodel.cpp \
+           $$PWD/accesspointsnapshot.cpp \
+           $$PWD/accesspointstore.cpp \
+           $$PWD/accesspointtracker.cpp \
+           $$PWD/accesspointviewmodel.cpp \
+           $$PWD/backendmetrics.cpp \
+           $$PWD/connectionstatemachine.cpp \
+           $$PWD/credentialstore.cpp \
+           $$PWD/strengthfilter.cpp \
+           $$PWD/updatescheduler.cpp \
+           $$PWD/userinputagent.cpp \
+           $$PWD/wifidevice.cpp
+
+HEADERS += $$PWD/wifibackend.h \
+           $$PWD/accesspointdecoder.h \
+           $$PWD/accesspointmodel.h \
+           $$PWD/accesspointsnapshot.h \
+           $$PWD/accesspointstore.h \
+           $$PWD/accesspointtracker.h \
+           $$PWD/accesspointviewmodel.h \
+           $$PWD/backendmetrics.h \
+           $$PWD/connectionstatemachine.h \
+           $$PWD/credentialstore.h \
+           $$PWD/strengthfilter.h \
+           $$PWD/updatescheduler.h \
+           $$PWD/userinputagent.h \
+           $$PWD/wifidevice.h
@@ -0,0 +1,308 @@
+#include "wifidevice.h"
+
+#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QElapsedTimer>
+#include <QMetaObject>
+
+#include <QDebug>
+
+#include "wifibackend.h"
+
+WiFiDevice::WiFiDevice(const QString &objectPath, BackendMetrics *metrics, QObject *parent) : QObject(parent)
+    , m_objectPath(objectPath)
+    , m_metrics(metrics)
+    , m_accessPointModel(new AccessPointModel(this))
+    , m_notifyScheduler(new UpdateScheduler(this))
+    , m_connectionStateMachine(new ConnectionStateMachine(metrics, this))
+{
+    // Not parented, it may be moved to its own thread in start()
+    m_tracker = new AccessPointTracker(m_metrics);
+    QObject::connect(m_tracker, &AccessPointTracker::published, this,
+            [this]() { m_notifyScheduler->schedule(); });
+
+    QObject::connect(m_notifyScheduler, &UpdateScheduler::triggered, this, &WiFiDevice::applyListSnapshot);
+
+    QObject::connect(m_accessPointModel, &QAbstractItemModel::dataChanged, this,
+            [this]() { m_metrics->increment(BackendMetrics::ModelRowsChanged); });
+
+    // The access point being connected to is fetched before any other
+    QObject::connect(m_connectionStateMachine, &ConnectionStateMachine::accessPointChanged, this,
+            [this]() {
+                QMetaObject::invokeMethod(m_tracker, "setPriorityPath", Q_ARG(QString, m_connectionStateMachine->objectPath()));
+            });
+}
+
+
+WiFiDevice::~WiFiDevice()
+{
+    if (m_trackerThread) {
+        // The tracker is deleted by the thread once its event loop has returned
+        m_trackerThread->quit();
+        m_trackerThread->wait();
+    } else {
+        delete m_tracker;
+    }
+}
+
+
+bool WiFiDevice::isPrimary() const
+{
+    return m_objectPath == connectivityDBusPath;
+}
+
+
+void WiFiDevice::restore(const AccessPointSnapshot &snapshot)
+{
+    // The tracker still lives in this thread, it publishes synchronously
+    m_tracker->restore(snapshot);
+
+    // First paint right away, the live state reconciles it afterwards
+    applyListSnapshot();
+}
+
+
+void WiFiDevice::start(bool workerThread)
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+
+    QString connectionName;
+    if (workerThread) {
+        // A private connection, so that its messages are dispatched in the worker thread
+        connectionName = QStringLiteral("pelux-wifi-tracker-%1").arg(quintptr(this), 0, 16);
+        m_trackerThread = new QThread(this);
+        m_trackerThread->setObjectName(QStringLiteral("WiFiAccessPointTracker"));
+        m_tracker->moveToThread(m_trackerThread);
+        QObject::connect(m_trackerThread, &QThread::finished, m_tracker, &QObject::deleteLater);
+        m_trackerThread->start();
+    }
+
+    QMetaObject::invokeMethod(m_tracker, "start", Q_ARG(QString, connectionName));
+
+    // The primary device is the manager object, WiFiBackend follows its properties
+    if (!isPrimary()) {
+        subscribe();
+        fetchProperties();
+    }
+}
+
+
+void WiFiDevice::setAccessPointPaths(const QList<QDBusObjectPath> &paths)
+{
+    QMetaObject::invokeMethod(m_tracker, "setAccessPointPaths", Q_ARG(QList<QDBusObjectPath>, paths));
+}
+
+
+void WiFiDevice::setExclusive(bool exclusive)
+{
+    QMetaObject::invokeMethod(m_tracker, "setExclusive", Q_ARG(bool, exclusive));
+}
+
+
+void WiFiDevice::setBulkFetchShared(bool shared)
+{
+    QMetaObject::invokeMethod(m_tracker, "setBulkFetchShared", Q_ARG(bool, shared));
+}
+
+
+void WiFiDevice::routePropertiesChangedFrom(WiFiDevice *primaryDevice)
+{
+    QMetaObject::invokeMethod(m_tracker, "setPropertiesChangedRouted", Q_ARG(bool, true));
+    QObject::connect(primaryDevice->tracker(), &AccessPointTracker::propertiesChangedNotHandled,
+            m_tracker, &AccessPointTracker::routedPropertiesChanged);
+}
+
+
+void WiFiDevice::adopt(const AccessPointSnapshot &accessPoints)
+{
+    QMetaObject::invokeMethod(m_tracker, "adopt", Q_ARG(AccessPointSnapshot, accessPoints));
+}
+
+
+void WiFiDevice::setStrengthFilter(const QVariantList &thresholds, int hysteresis, int minInterval)
+{
+    QMetaObject::invokeMethod(m_tracker, "setStrengthFilter",
+            Q_ARG(QVariantList, thresholds), Q_ARG(int, hysteresis), Q_ARG(int, minInterval));
+}
+
+
+void WiFiDevice::setVisiblePaths(const QStringList &paths)
+{
+    QMetaObject::invokeMethod(m_tracker, "setVisiblePaths", Q_ARG(QStringList, paths));
+}
+
+
+void WiFiDevice::serviceLost()
+{
+    QMetaObject::invokeMethod(m_tracker, "serviceLost");
+}
+
+
+void WiFiDevice::resync()
+{
+    QMetaObject::invokeMethod(m_tracker, "resync");
+    if (!isPrimary()) {
+        // The match rule was resolved against the previous owner of the name
+        unsubscribe();
+        subscribe();
+        fetchProperties();
+    }
+}
+
+
+void WiFiDevice::setSuspended(bool suspended)
+{
+    QMetaObject::invokeMethod(m_tracker, "setSuspended", Q_ARG(bool, suspended));
+}
+
+
+void WiFiDevice::subscribe()
+{
+    WiFiBackend::dbusConnection().connect(connectivityDBusService, m_objectPath, dbusPropertyInterface,
+            QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
+}
+
+
+void WiFiDevice::unsubscribe()
+{
+    WiFiBackend::dbusConnection().disconnect(connectivityDBusService, m_objectPath, dbusPropertyInterface,
+            QStringLiteral("PropertiesChanged"), this, SLOT(propertiesChangedHandler(QDBusMessage)));
+}
+
+
+void WiFiDevice::fetchProperties()
+{
+    QDBusMessage dbusMessageRequestProperties =
+        QDBusMessage::createMethodCall(connectivityDBusService, m_objectPath, dbusPropertyInterface, "GetAll" );
+    QVariantList args;
+    args.append(QVariant::fromValue( wifiDeviceDBusInterface ));
+    dbusMessageRequestProperties.setArguments(args);
+
+    QElapsedTimer callTimer;
+    callTimer.start();
+    QDBusPendingCall pendingCall = WiFiBackend::dbusConnection().asyncCall(dbusMessageRequestProperties, ASYNC_CALL_TIMEOUT);
+    QDBusPendingCallWatcher *pendingCallWatcher = new QDBusPendingCallWatcher(pendingCall, this);
+
+    QObject::connect(pendingCallWatcher, &QDBusPendingCallWatcher::finished, this,
+            [this, callTimer](QDBusPendingCallWatcher *watcher) {
+                m_metrics->recordLatency(BackendMetrics::GetAll, callTimer.nsecsElapsed());
+                QDBusPendingReply<void> reply = *watcher;
+
+                if (reply.isError()) {
+                    qWarning() << Q_FUNC_INFO << m_objectPath << reply.error().message();
+                } else {
+                    QDBusMessage message = reply.reply();
+                    const QDBusArgument arg = message.arguments().first().value<QDBusArgument>();
+                    applyProperties(arg);
+                }
+                watcher->deleteLater();
+            });
+}
+
+
+void WiFiDevice::applyProperties(const QDBusArgument &properties)
+{
+    properties.beginMap();
+    while (!properties.atEnd()) {
+        properties.beginMapEntry();
+        QString propertyName;
+        QVariant propertyValue;
+        properties >> propertyName >> propertyValue;
+
+        if (propertyName == "WiFiAvailable") {
+            setAvailable( propertyValue.toBool() );
+        } else if (propertyName == "WiFiAccessPoints") {
+            QList<QDBusObjectPath> paths;
+            const QDBusArgument arg = propertyValue.value<QDBusArgument>();
+            arg.beginArray();
+            while (!arg.atEnd()) {
+                QDBusObjectPath path;
+                arg >> path;
+                paths.append(path);
+            }
+            arg.endArray();
+            setAccessPointPaths(paths);
+        }
+
+        properties.endMapEntry();
+    }
+    properties.endMap();
+}
+
+
+void WiFiDevice::propertiesChangedHandler(const QDBusMessage &message)
+{
+    m_metrics->increment(BackendMetrics::PropertiesChangedReceived);
+
+    const QVariantList arguments = message.arguments();
+    if (arguments.value(0) == wifiDeviceDBusInterface) {
+        m_metrics->increment(BackendMetrics::PropertiesChangedDecoded);
+        applyProperties(arguments.value(1).value<QDBusArgument>());
+    }
+}
+
+
+void WiFiDevice::applyListSnapshot()
+{
+    const AccessPointListSnapshotPtr snapshot = m_tracker->snapshot();
+    if (m_listSnapshot && m_listSnapshot->version == snapshot->version) {
+        return;
+    }
+
+    // The same list with other flags, after a restart of the manager or a no-op scan
+    const bool listChanged = !m_listSnapshot || m_listSnapshot->store.revision() != snapshot->store.revision();
+
+    // Only implicitly shared copies, all decoding happened in the tracker
+    m_listSnapshot = snapshot;
+    if (!listChanged) {
+        setAccessPointsStale(snapshot->stale);
+        emit listSnapshotChanged();
+        return;
+    }
+    m_accessPointStore = snapshot->store;
+    m_accessPoints = snapshot->accessPoints;
+
+    m_accessPointModel->sync(m_accessPointStore);
+    setAccessPointsStale(snapshot->stale);
+
+    // The active access point first, it may have been left for another one
+    const QString activeObjectPath = m_connectionStateMachine->objectPath();
+    if (!activeObjectPath.isEmpty() && activeObjectPath != snapshot->connectedObjectPath) {
+        const AccessPointStore::PathId activeId = m_accessPointStore.pathId(activeObjectPath);
+        if (m_accessPointStore.contains(activeId)) {
+            m_connectionStateMachine->updateAccessPoint(activeObjectPath, m_accessPointStore.accessPoint(activeId));
+        } else {
+            m_connectionStateMachine->removeAccessPoint(activeObjectPath);
+        }
+    }
+
+    if (!snapshot->connectedObjectPath.isEmpty()) {
+        const AccessPointStore::PathId connectedId = m_accessPointStore.pathId(snapshot->connectedObjectPath);
+        m_connectionStateMachine->updateAccessPoint(snapshot->connectedObjectPath, m_accessPointStore.accessPoint(connectedId));
+    }
+
+    emit accessPointsChanged();
+    emit listSnapshotChanged();
+}
+
+
+void WiFiDevice::setAvailable(bool available)
+{
+    if (m_available == available)
+        return;
+    m_available = available;
+    emit availableChanged(m_available);
+}
+
+
+void WiFiDevice::setAccessPointsStale(bool accessPointsStale)
+{
+    if (m_accessPointsStale == accessPointsStale)
+        return;
+    m_accessPointsStale = accessPointsStale;
+    emit accessPointsStaleChanged(m_accessPointsStale);
+}
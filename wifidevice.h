@@ -0,0 +1,121 @@
+#ifndef CONNECTIVITY_WIFIDEVICE_H_
+#define CONNECTIVITY_WIFIDEVICE_H_
+
+#include <QObject>
+#include <QVariant>
+
+#include <QDBusArgument>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QThread>
+
+#include "accesspointmodel.h"
+#include "accesspointsnapshot.h"
+#include "accesspointstore.h"
+#include "accesspointtracker.h"
+#include "backendmetrics.h"
+#include "connectionstatemachine.h"
+#include "updatescheduler.h"
+
+/*
+ * One WiFi radio of the connectivity manager: the access points it sees and
+ * the connection it holds.
+ *
+ * Every device has a tracker of its own, with its own subscriptions, store and
+ * snapshots, its own model and its own connection state machine, so updates of
+ * one radio never invalidate or re-emit the list of another. The manager object
+ * itself is the primary device, whose properties are handled by WiFiBackend;
+ * further radios are exported as WiFiDevice objects and read their own.
+ */
+class WiFiDevice : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString objectPath READ objectPath CONSTANT)
+    Q_PROPERTY(bool available READ available NOTIFY availableChanged)
+    Q_PROPERTY(QVariantList accessPoints READ accessPoints NOTIFY accessPointsChanged)
+    Q_PROPERTY(AccessPointModel *accessPointModel READ accessPointModel CONSTANT)
+    Q_PROPERTY(ConnectionStateMachine *connectionStateMachine READ connectionStateMachine CONSTANT)
+    Q_PROPERTY(bool accessPointsStale READ accessPointsStale NOTIFY accessPointsStaleChanged)
+
+public:
+    explicit WiFiDevice(const QString &objectPath, BackendMetrics *metrics, QObject *parent = nullptr);
+    ~WiFiDevice();
+
+    const QString &objectPath() const { return m_objectPath; }
+    bool isPrimary() const;
+    bool available() const { return m_available; }
+    const QVariantList &accessPoints() const { return m_accessPoints; }
+    AccessPointModel *accessPointModel() const { return m_accessPointModel; }
+    ConnectionStateMachine *connectionStateMachine() const { return m_connectionStateMachine; }
+    UpdateScheduler *updateScheduler() const { return m_notifyScheduler; }
+    AccessPointTracker *tracker() const { return m_tracker; }
+    bool accessPointsStale() const { return m_accessPointsStale; }
+
+    // Copies of the latest snapshot published by the tracker, read on this thread only
+    const AccessPointListSnapshotPtr &listSnapshot() const { return m_listSnapshot; }
+    const AccessPointStore &accessPointStore() const { return m_accessPointStore; }
+
+    // Seeds the list from a persisted snapshot, to be called before start()
+    void restore(const AccessPointSnapshot &snapshot);
+    // Decodes in a thread of its own with a private connection if workerThread is set
+    void start(bool workerThread);
+
+    void setAccessPointPaths(const QList<QDBusObjectPath> &paths);
+    void setExclusive(bool exclusive);
+    // The access points come from the primary device's bulk fetch, see AccessPointTracker::adopt()
+    void setBulkFetchShared(bool shared);
+    // The PropertiesChanged of its access points come from the primary device's tracker
+    void routePropertiesChangedFrom(WiFiDevice *primaryDevice);
+    void adopt(const AccessPointSnapshot &accessPoints);
+    void setStrengthFilter(const QVariantList &thresholds, int hysteresis, int minInterval);
+    void serviceLost();
+    void resync();
+    // Only the active access point is followed while suspended
+    void setSuspended(bool suspended);
+
+    // Object paths of the rows the UI shows, from any of the models; their details are fetched first
+    Q_INVOKABLE void setVisiblePaths(const QStringList &paths);
+
+    // Only for the primary device, the others read their own properties
+    void setAvailable(bool available);
+
+Q_SIGNALS:
+    void availableChanged(bool available);
+    // Only when the list itself changed
+    void accessPointsChanged();
+    // Any newer snapshot, also one which only differs in its stale flag or generation
+    void listSnapshotChanged();
+    void accessPointsStaleChanged(bool accessPointsStale);
+
+private Q_SLOTS:
+    void propertiesChangedHandler(const QDBusMessage &message);
+
+private:
+    void subscribe();
+    void unsubscribe();
+    void fetchProperties();
+    void applyProperties(const QDBusArgument &properties);
+    void applyListSnapshot();
+    void setAccessPointsStale(bool accessPointsStale);
+
+    QString m_objectPath;
+    BackendMetrics *m_metrics = nullptr;
+
+    AccessPointTracker *m_tracker = nullptr;
+    QThread *m_trackerThread = nullptr;
+    bool m_started = false;
+
+    AccessPointListSnapshotPtr m_listSnapshot;
+    AccessPointStore m_accessPointStore;
+    QVariantList m_accessPoints;
+    AccessPointModel *m_accessPointModel = nullptr;
+    bool m_accessPointsStale = false;
+    bool m_available = false;
+
+    // Model refresh from the latest tracker snapshot
+    UpdateScheduler *m_notifyScheduler = nullptr;
+
+    ConnectionStateMachine *m_connectionStateMachine = nullptr;
+};
+
+#endif // CONNECTIVITY_WIFIDEVICE_H_